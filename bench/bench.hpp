@@ -0,0 +1,395 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ benchmark harness
+
+ 1. every benchmark body is calibrated to a batch size that runs for at least
+    --min-time-ms, then warmed up for --warmup-ms;
+ 2. --reps samples are taken, each sample is the time of one batch divided by
+    the batch size; min/median/mean/stddev/p90/max are reported per iteration;
+ 3. hardware counters (cycles, instructions, cache and branch misses) are
+    sampled through perf_event_open when the kernel allows it, otherwise
+    they are reported as null; they cover the threads and processes started
+    after run() began, so pools must be created lazily (ThreadPool::global())
+    or inside a body rather than in main before run();
+ 4. --json=<file> writes the results, bench_compare diffs two such files.
+
+ usage:
+    int main(int argc, char *argv[]) {
+      Harness harness("graph");
+      harness.add("build", [] { ... });
+      return harness.run(argc, argv);
+    }
+*/
+
+// keep the optimizer from dropping a value or folding the computation
+template <typename T> inline void doNotOptimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void *sink;
+  sink = &value;
+#endif
+}
+
+inline void clobberMemory() {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+// drops everything written to std::cout while alive, the demo functors
+// print on every call
+struct SilenceStdout {
+  std::streambuf *old;
+  SilenceStdout() : old(std::cout.rdbuf(nullptr)) {}
+  ~SilenceStdout() {
+    std::cout.rdbuf(old);
+    std::cout.clear();
+  }
+};
+
+struct SampleStats {
+  double min = 0, max = 0, mean = 0, median = 0, stddev = 0, p90 = 0;
+
+  static SampleStats of(std::vector<double> samples) {
+    SampleStats s;
+    if (samples.empty())
+      return s;
+    std::sort(samples.begin(), samples.end());
+    auto n = samples.size();
+    s.min = samples.front();
+    s.max = samples.back();
+    for (double v : samples)
+      s.mean += v;
+    s.mean /= n;
+    for (double v : samples)
+      s.stddev += (v - s.mean) * (v - s.mean);
+    s.stddev = n > 1 ? std::sqrt(s.stddev / (n - 1)) : 0.0;
+    s.median = n % 2 ? samples[n / 2]
+                     : (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+    s.p90 = samples[std::min(n - 1, static_cast<std::size_t>(n * 0.9))];
+    return s;
+  }
+};
+
+// hardware counters of the calling thread and of every thread or process it
+// starts afterwards (inherit), one perf event group
+class PerfCounters {
+public:
+  static constexpr const char *names[] = {"cycles", "instructions",
+                                          "cache_misses", "branch_misses"};
+  static constexpr std::size_t count = std::size(names);
+
+  PerfCounters() {
+#if defined(__linux__)
+    const uint64_t configs[count] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (std::size_t i = 0; i < count; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = i == 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.inherit = 1; // pool workers, channel threads, forked workers
+      attr.read_format = PERF_FORMAT_GROUP;
+      int fd = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds_[0], 0));
+      if (fd < 0) {
+        close();
+        return;
+      }
+      fds_[i] = fd;
+    }
+    available_ = true;
+#endif
+  }
+  ~PerfCounters() { close(); }
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool available() const { return available_; }
+
+  void start() {
+#if defined(__linux__)
+    if (!available_)
+      return;
+    ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  // counter values since start(), zeros when unavailable
+  std::vector<double> stop() {
+    std::vector<double> values(count, 0.0);
+#if defined(__linux__)
+    if (!available_)
+      return values;
+    ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t buffer[1 + count] = {};
+    if (::read(fds_[0], buffer, sizeof(buffer)) > 0)
+      for (std::size_t i = 0; i < count && i < buffer[0]; ++i)
+        values[i] = static_cast<double>(buffer[1 + i]);
+#endif
+    return values;
+  }
+
+private:
+  int fds_[count] = {-1, -1, -1, -1};
+  bool available_ = false;
+
+  void close() {
+#if defined(__linux__)
+    for (int &fd : fds_) {
+      if (fd >= 0)
+        ::close(fd);
+      fd = -1;
+    }
+#endif
+    available_ = false;
+  }
+};
+
+struct BenchResult {
+  std::string name;
+  uint64_t batch = 0; // iterations per sample
+  std::vector<double> samples; // ns per iteration
+  SampleStats stats;
+  bool hasCounters = false;
+  std::vector<double> counters; // per iteration, median over samples
+};
+
+class Harness {
+public:
+  using Body = std::function<void()>;
+
+  explicit Harness(std::string suite) : suite_(std::move(suite)) {}
+
+  void add(std::string name, Body body) {
+    benchmarks_.push_back({std::move(name), std::move(body)});
+  }
+
+  int run(int argc, char *argv[]) {
+    if (!parse(argc, argv))
+      return 2;
+
+    PerfCounters counters;
+    std::vector<BenchResult> results;
+    std::cout << std::left << std::setw(36) << suite_ + " benchmark"
+              << std::right << std::setw(12) << "median ns" << std::setw(12)
+              << "stddev" << std::setw(12) << "p90"
+              << std::setw(12) << "batch" << std::endl;
+    for (auto &bench : benchmarks_) {
+      if (!filter_.empty() && bench.name.find(filter_) == std::string::npos)
+        continue;
+      results.push_back(measure(bench.name, bench.body, counters));
+      const auto &r = results.back();
+      std::cout << std::left << std::setw(36) << r.name << std::right
+                << std::fixed << std::setprecision(2) << std::setw(12)
+                << r.stats.median << std::setw(12) << r.stats.stddev
+                << std::setw(12) << r.stats.p90 << std::setw(12) << r.batch
+                << std::endl;
+    }
+    if (!counters.available())
+      std::cout << "(hardware counters unavailable, see "
+                   "/proc/sys/kernel/perf_event_paranoid)"
+                << std::endl;
+
+    if (!json_.empty()) {
+      std::ofstream out(json_);
+      if (!out) {
+        std::cerr << "cannot write " << json_ << std::endl;
+        return 1;
+      }
+      writeJson(out, results, counters.available());
+    }
+    return 0;
+  }
+
+private:
+  struct Entry {
+    std::string name;
+    Body body;
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  std::string suite_;
+  std::vector<Entry> benchmarks_;
+  std::string filter_;
+  std::string json_;
+  int reps_ = 20;
+  double warmupMs_ = 50;
+  double minTimeMs_ = 5;
+
+  bool parse(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i) {
+      std::string_view arg = argv[i];
+      auto value = [&](std::string_view key) -> const char * {
+        return arg.starts_with(key) ? argv[i] + key.size() : nullptr;
+      };
+      if (auto v = value("--filter="))
+        filter_ = v;
+      else if (auto v = value("--json="))
+        json_ = v;
+      else if (auto v = value("--reps="))
+        reps_ = std::max(1, std::atoi(v));
+      else if (auto v = value("--warmup-ms="))
+        warmupMs_ = std::atof(v);
+      else if (auto v = value("--min-time-ms="))
+        minTimeMs_ = std::atof(v);
+      else {
+        std::cerr << "usage: " << argv[0]
+                  << " [--filter=substr] [--json=file] [--reps=N]"
+                     " [--warmup-ms=ms] [--min-time-ms=ms]"
+                  << std::endl;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static double elapsedNs(Clock::time_point begin) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - begin)
+        .count();
+  }
+
+  static double runBatch(const Body &body, uint64_t batch) {
+    auto begin = Clock::now();
+    for (uint64_t i = 0; i < batch; ++i)
+      body();
+    return elapsedNs(begin);
+  }
+
+  BenchResult measure(const std::string &name, const Body &body,
+                      PerfCounters &counters) {
+    BenchResult result;
+    result.name = name;
+
+    // the first call pays for lazy initialization, keep it out of calibration
+    body();
+
+    // calibrate: grow the batch until one sample is long enough to time
+    uint64_t batch = 1;
+    double minTimeNs = minTimeMs_ * 1e6;
+    for (;;) {
+      double ns = runBatch(body, batch);
+      if (ns >= minTimeNs || batch >= (uint64_t(1) << 40))
+        break;
+      double scale = ns > 0 ? minTimeNs / ns * 1.2 : 10.0;
+      batch = std::max(batch + 1,
+                       static_cast<uint64_t>(batch * std::min(scale, 10.0)));
+    }
+    result.batch = batch;
+
+    auto warmupBegin = Clock::now();
+    while (elapsedNs(warmupBegin) < warmupMs_ * 1e6)
+      runBatch(body, batch);
+
+    std::vector<std::vector<double>> counterSamples(PerfCounters::count);
+    for (int rep = 0; rep < reps_; ++rep) {
+      counters.start();
+      double ns = runBatch(body, batch);
+      auto values = counters.stop();
+      result.samples.push_back(ns / batch);
+      for (std::size_t i = 0; i < values.size(); ++i)
+        counterSamples[i].push_back(values[i] / batch);
+    }
+    result.stats = SampleStats::of(result.samples);
+    result.hasCounters = counters.available();
+    if (result.hasCounters)
+      for (auto &samples : counterSamples)
+        result.counters.push_back(SampleStats::of(samples).median);
+    return result;
+  }
+
+  // quoted and escaped, benchmark names are free text
+  static void writeJsonString(std::ostream &os, std::string_view text) {
+    os << '"';
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        os << '\\' << c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+                      static_cast<unsigned>(c));
+        os << escaped;
+      } else {
+        os << c;
+      }
+    }
+    os << '"';
+  }
+
+  void writeJson(std::ostream &os, const std::vector<BenchResult> &results,
+                 bool hasCounters) const {
+    char host[256] = "unknown";
+#if defined(__linux__)
+    gethostname(host, sizeof(host) - 1);
+#endif
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ",
+                  std::gmtime(&now));
+
+    os << std::setprecision(6) << std::fixed;
+    os << "{\n  \"suite\": ";
+    writeJsonString(os, suite_);
+    os << ",\n  \"context\": {\"date\": \"" << date << "\", \"host\": ";
+    writeJsonString(os, host);
+    os << ", \"threads\": " << std::thread::hardware_concurrency()
+       << ", \"perf_counters\": " << (hasCounters ? "true" : "false")
+       << ", \"reps\": " << reps_ << "},\n";
+    os << "  \"benchmarks\": [";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const auto &r = results[i];
+      const auto &s = r.stats;
+      os << (i ? "," : "") << "\n    {\"name\": ";
+      writeJsonString(os, r.name);
+      os << ", \"batch\": " << r.batch << ", \"ns_per_iter\": {\"min\": "
+         << s.min << ", \"median\": " << s.median << ", \"mean\": " << s.mean
+         << ", \"stddev\": " << s.stddev << ", \"p90\": " << s.p90
+         << ", \"max\": " << s.max << "}, \"counters\": ";
+      if (r.hasCounters) {
+        os << "{";
+        for (std::size_t c = 0; c < r.counters.size(); ++c)
+          os << (c ? ", " : "") << "\"" << PerfCounters::names[c]
+             << "\": " << r.counters[c];
+        os << "}";
+      } else {
+        os << "null";
+      }
+      os << "}";
+    }
+    os << "\n  ]\n}\n";
+  }
+};
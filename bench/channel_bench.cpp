@@ -0,0 +1,126 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../coroutine/channel.hpp"
+#include "../coroutine/task.hpp"
+#include "../graph/frame_pipeline.hpp"
+#include "bench.hpp"
+
+// 2 producers and 2 consumers move 100k messages through a 256 slot queue;
+// the coroutines start on their own threads like the threads of the
+// mutex + condition variable baseline
+constexpr uint64_t total = 100000;
+constexpr int producers = 2;
+constexpr int consumers = 2;
+
+Task produce(Channel<uint64_t> &channel, uint64_t begin, uint64_t end,
+             std::size_t batch) {
+  if (batch == 1) {
+    for (uint64_t i = begin; i < end; ++i)
+      co_await channel.send(i);
+    co_return;
+  }
+  std::vector<uint64_t> items;
+  for (uint64_t i = begin; i < end; ++i) {
+    items.push_back(i);
+    if (items.size() == batch || i + 1 == end) {
+      co_await channel.sendBatch(items);
+      items.clear();
+    }
+  }
+}
+
+Task consume(Channel<uint64_t> &channel, std::size_t batch,
+             std::atomic<uint64_t> &sum) {
+  uint64_t local = 0;
+  if (batch == 1) {
+    while (auto item = co_await channel.recv())
+      local += *item;
+  } else {
+    std::vector<uint64_t> items(batch);
+    while (std::size_t n = co_await channel.recvBatch(items))
+      for (std::size_t i = 0; i < n; ++i)
+        local += items[i];
+  }
+  sum += local;
+}
+
+void channelRun(std::size_t batch) {
+  Channel<uint64_t> channel(256);
+  std::atomic<uint64_t> sum = 0;
+  std::vector<Task> receivers, senders;
+  receivers.reserve(consumers);
+  senders.reserve(producers);
+  {
+    std::vector<std::thread> threads;
+    std::atomic_flag guard = ATOMIC_FLAG_INIT;
+    auto keep = [&guard](std::vector<Task> &tasks, Task task) {
+      while (guard.test_and_set())
+        std::this_thread::yield();
+      tasks.push_back(std::move(task));
+      guard.clear();
+    };
+    for (int c = 0; c < consumers; ++c)
+      threads.emplace_back(
+          [&] { keep(receivers, consume(channel, batch, sum)); });
+    for (int p = 0; p < producers; ++p)
+      threads.emplace_back([&, p] {
+        uint64_t share = total / producers;
+        keep(senders, produce(channel, p * share, (p + 1) * share, batch));
+      });
+    for (auto &thread : threads)
+      thread.join();
+  }
+  for (auto &task : senders)
+    task.wait();
+  channel.close();
+  for (auto &task : receivers)
+    task.wait();
+  doNotOptimize(sum.load());
+}
+
+void mutexQueueRun() {
+  BoundedQueue<uint64_t> queue(256);
+  std::atomic<uint64_t> sum = 0;
+  std::vector<std::thread> threads;
+  for (int c = 0; c < consumers; ++c)
+    threads.emplace_back([&] {
+      uint64_t local = 0;
+      while (auto item = queue.pop())
+        local += *item;
+      sum += local;
+    });
+  std::vector<std::thread> senders;
+  for (int p = 0; p < producers; ++p)
+    senders.emplace_back([&, p] {
+      uint64_t share = total / producers;
+      for (uint64_t i = p * share; i < (p + 1) * share; ++i)
+        queue.push(i);
+    });
+  for (auto &thread : senders)
+    thread.join();
+  queue.close();
+  for (auto &thread : threads)
+    thread.join();
+  doNotOptimize(sum.load());
+}
+
+int main(int argc, char *argv[]) {
+  Harness harness("channel");
+
+  harness.add("channel/mpmc_100k", [] { channelRun(1); });
+  harness.add("channel/mpmc_batch32_100k", [] { channelRun(32); });
+  harness.add("mutex_queue/mpmc_100k", [] { mutexQueueRun(); });
+
+  // uncontended fast path: one coroutine, no waiting
+  Channel<uint64_t> single(1024);
+  harness.add("channel/try_send_recv", [&single] {
+    uint64_t v = 1;
+    single.trySend(v);
+    doNotOptimize(single.tryRecv());
+  });
+
+  return harness.run(argc, argv);
+}
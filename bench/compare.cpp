@@ -0,0 +1,259 @@
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+/**
+ compares two result files written by Harness --json
+
+    bench_compare baseline.json candidate.json [--threshold=5]
+
+ prints the change of the median per benchmark and exits with 1 when any
+ benchmark got slower by more than the threshold (in percent).
+*/
+
+struct Json {
+  using Object = std::map<std::string, Json>;
+  using Array = std::vector<Json>;
+  std::variant<std::nullptr_t, bool, double, std::string,
+               std::shared_ptr<Array>, std::shared_ptr<Object>>
+      value;
+
+  const Json *get(const std::string &key) const {
+    auto object = std::get_if<std::shared_ptr<Object>>(&value);
+    if (!object)
+      return nullptr;
+    auto it = (*object)->find(key);
+    return it == (*object)->end() ? nullptr : &it->second;
+  }
+  const Array *array() const {
+    auto array = std::get_if<std::shared_ptr<Array>>(&value);
+    return array ? array->get() : nullptr;
+  }
+  double number(double fallback = NAN) const {
+    auto number = std::get_if<double>(&value);
+    return number ? *number : fallback;
+  }
+  std::string string() const {
+    auto string = std::get_if<std::string>(&value);
+    return string ? *string : std::string();
+  }
+};
+
+// just enough JSON for the files the harness writes
+class JsonParser {
+  std::string_view text_;
+  std::size_t pos_ = 0;
+
+  void skipSpace() {
+    while (pos_ < text_.size() && std::isspace(text_[pos_]))
+      ++pos_;
+  }
+  bool consume(char c) {
+    skipSpace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+  void expect(char c) {
+    if (!consume(c))
+      throw std::runtime_error(std::string("expected '") + c + "' at " +
+                               std::to_string(pos_));
+  }
+
+  std::string parseString() {
+    expect('"');
+    std::string out;
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      if (text_[pos_] != '\\' || pos_ + 1 >= text_.size()) {
+        out += text_[pos_++];
+        continue;
+      }
+      char c = text_[pos_ + 1];
+      pos_ += 2;
+      switch (c) {
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        // bench.hpp only writes control characters this way, code points
+        // above U+007F are kept as UTF-8
+        if (pos_ + 4 > text_.size())
+          throw std::runtime_error("short \\u escape at " +
+                                   std::to_string(pos_));
+        unsigned code = std::stoul(std::string(text_.substr(pos_, 4)),
+                                   nullptr, 16);
+        pos_ += 4;
+        if (code < 0x80) {
+          out += static_cast<char>(code);
+        } else if (code < 0x800) {
+          out += static_cast<char>(0xc0 | code >> 6);
+          out += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+          out += static_cast<char>(0xe0 | code >> 12);
+          out += static_cast<char>(0x80 | (code >> 6 & 0x3f));
+          out += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        break;
+      }
+      default: // \" \\ \/
+        out += c;
+      }
+    }
+    expect('"');
+    return out;
+  }
+
+public:
+  explicit JsonParser(std::string_view text) : text_(text) {}
+
+  Json parse() {
+    skipSpace();
+    if (pos_ >= text_.size())
+      throw std::runtime_error("unexpected end of input");
+    char c = text_[pos_];
+    if (c == '{') {
+      auto object = std::make_shared<Json::Object>();
+      ++pos_;
+      if (!consume('}')) {
+        do {
+          std::string key = parseString();
+          expect(':');
+          (*object)[key] = parse();
+        } while (consume(','));
+        expect('}');
+      }
+      return {object};
+    }
+    if (c == '[') {
+      auto array = std::make_shared<Json::Array>();
+      ++pos_;
+      if (!consume(']')) {
+        do {
+          array->push_back(parse());
+        } while (consume(','));
+        expect(']');
+      }
+      return {array};
+    }
+    if (c == '"')
+      return {parseString()};
+    if (text_.substr(pos_, 4) == "null") {
+      pos_ += 4;
+      return {nullptr};
+    }
+    if (text_.substr(pos_, 4) == "true") {
+      pos_ += 4;
+      return {true};
+    }
+    if (text_.substr(pos_, 5) == "false") {
+      pos_ += 5;
+      return {false};
+    }
+    const char *begin = text_.data() + pos_;
+    char *end = nullptr;
+    double number = std::strtod(begin, &end);
+    if (end == begin)
+      throw std::runtime_error("bad value at " + std::to_string(pos_));
+    pos_ += end - begin;
+    return {number};
+  }
+};
+
+static std::map<std::string, double> loadMedians(const char *path) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error(std::string("cannot read ") + path);
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  std::string text = buffer.str();
+  Json root = JsonParser(text).parse();
+
+  std::map<std::string, double> medians;
+  const Json *benchmarks = root.get("benchmarks");
+  if (!benchmarks || !benchmarks->array())
+    throw std::runtime_error(std::string(path) + ": no benchmarks array");
+  std::string suite = root.get("suite") ? root.get("suite")->string() : "";
+  for (const auto &bench : *benchmarks->array()) {
+    const Json *name = bench.get("name");
+    const Json *ns = bench.get("ns_per_iter");
+    const Json *median = ns ? ns->get("median") : nullptr;
+    if (name && median)
+      medians[suite + ":" + name->string()] = median->number();
+  }
+  return medians;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0]
+              << " baseline.json candidate.json [--threshold=percent]"
+              << std::endl;
+    return 2;
+  }
+  double threshold = 5.0;
+  for (int i = 3; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    if (arg.starts_with("--threshold="))
+      threshold = std::atof(argv[i] + 12);
+  }
+
+  try {
+    auto baseline = loadMedians(argv[1]);
+    auto candidate = loadMedians(argv[2]);
+
+    int regressions = 0;
+    std::cout << std::left << std::setw(44) << "benchmark" << std::right
+              << std::setw(14) << "baseline ns" << std::setw(14)
+              << "candidate ns" << std::setw(10) << "change" << std::endl;
+    for (const auto &[name, before] : baseline) {
+      auto it = candidate.find(name);
+      if (it == candidate.end()) {
+        std::cout << std::left << std::setw(44) << name
+                  << "  missing in candidate" << std::endl;
+        continue;
+      }
+      double after = it->second;
+      double change = before > 0 ? (after - before) / before * 100.0 : 0.0;
+      bool regressed = change > threshold;
+      regressions += regressed;
+      std::cout << std::left << std::setw(44) << name << std::right
+                << std::fixed << std::setprecision(2) << std::setw(14)
+                << before << std::setw(14) << after << std::setw(9)
+                << std::showpos << change << "%" << std::noshowpos
+                << (regressed ? "  REGRESSION" : "") << std::endl;
+    }
+    for (const auto &[name, after] : candidate)
+      if (!baseline.count(name))
+        std::cout << std::left << std::setw(44) << name << "  new"
+                  << std::endl;
+    return regressions ? 1 : 0;
+  } catch (const std::exception &ex) {
+    std::cerr << "Exception: " << ex.what() << '\n';
+    return 2;
+  }
+}
@@ -0,0 +1,38 @@
+#include <cstdint>
+
+#include "../coroutine/generator.hpp"
+#include "bench.hpp"
+
+Generator<uint64_t> iota(uint64_t n) {
+  for (uint64_t i = 0; i < n; ++i)
+    co_yield i;
+}
+
+int main(int argc, char *argv[]) {
+  Harness harness("generator");
+
+  harness.add("generator/create_destroy", [] {
+    auto gen = iota(0);
+    doNotOptimize(gen.h_);
+  });
+
+  harness.add("generator/iterate_1k", [] {
+    uint64_t sum = 0;
+    auto gen = iota(1000);
+    while (gen)
+      sum += gen();
+    doNotOptimize(sum);
+  });
+
+  // baseline: the loop the coroutine replaces
+  harness.add("baseline/loop_1k", [] {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < 1000; ++i) {
+      doNotOptimize(i);
+      sum += i;
+    }
+    doNotOptimize(sum);
+  });
+
+  return harness.run(argc, argv);
+}
@@ -0,0 +1,235 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../graph/frame_pipeline.hpp"
+#include "../graph/graph.hpp"
+#include "../graph/pass_graph.hpp"
+#include "bench.hpp"
+
+// the virtual dispatch of Functor::operator(), several implementations so
+// the call site stays polymorphic
+template <uint32_t K> struct AddFunctor : public Functor<uint32_t, uint32_t> {
+  uint32_t operator()(const uint32_t &input) override { return input + K; }
+};
+
+// move assignment between frame maps of different arenas moves element-wise
+// and must drop the old contents of the target
+bool frameMapMoveAssignment() {
+  FrameArena a, b;
+  FrameHashMap<uint32_t, uint32_t> target(&a), source(&b);
+  for (uint32_t i = 0; i < 5; ++i)
+    target[i] = i;
+  for (uint32_t i = 10; i < 13; ++i)
+    source[i] = i;
+  target = std::move(source);
+  std::size_t count = 0;
+  for (auto &[key, value] : target)
+    count += key == value;
+  return target.size() == 3 && count == 3 && source.empty();
+}
+
+int main(int argc, char *argv[]) {
+  Harness harness("graph");
+
+  // full deferred shading frame: load, G-buffer, lighting, post, present
+  harness.add("build/deferred_shading", [] {
+    SilenceStdout silence;
+    NamingPool::reset();
+    deferredShading();
+  });
+
+  // the same frame with names and maps in a double buffered frame arena
+  DoubleBufferedArena arenas;
+  harness.add("build/deferred_shading_arena", [&arenas] {
+    SilenceStdout silence;
+    FrameScope scope(arenas.flip());
+    NamingPool::reset();
+    deferredShading();
+  });
+
+  // every pass output comes from the cache after the first frame; the
+  // surrogate inputs are random, so the generator is reseeded per frame
+  auto cacheDir = std::filesystem::temp_directory_path() / "bench_pass_cache";
+  std::filesystem::remove_all(cacheDir);
+  PassCache cache(cacheDir, uint64_t(64) << 20);
+  harness.add("build/deferred_shading_cached", [&cache] {
+    SilenceStdout silence;
+    srand(1);
+    NamingPool::reset();
+    deferredShading(&cache);
+  });
+
+  harness.add("build/load_functor", [] {
+    SilenceStdout silence;
+    auto node = LoadFunctor<ImageData>()(ImageData{1920, 1080, 1, 0, 0});
+    doNotOptimize(node);
+  });
+
+  harness.add("naming/get_name", [] {
+    static const std::string names[] = {"position", "normal", "albedo",
+                                        "specular", "lightMap", "post"};
+    for (const auto &name : names)
+      doNotOptimize(NamingPool::getName(name));
+  });
+
+  harness.add("edges/record", [] {
+    EdgeRecorder recorder;
+    recorder.record("colorMap", "gbuffer");
+    recorder.record("normalMap", "gbuffer");
+    recorder.record("depthMap", "gbuffer");
+    recorder.record("gbuffer", "lighting");
+    recorder.record("lighting", "post");
+    recorder.record("post", "present");
+    doNotOptimize(recorder);
+  });
+
+  // 64 small graph allocations per frame, arena vs global heap
+  FrameArena arena;
+  harness.add("alloc/frame_arena_x64", [&arena] {
+    for (int i = 0; i < 64; ++i)
+      doNotOptimize(arena.allocate(48 + i, alignof(std::max_align_t)));
+    arena.reset();
+  });
+  harness.add("alloc/new_delete_x64", [] {
+    void *blocks[64];
+    for (int i = 0; i < 64; ++i)
+      doNotOptimize(blocks[i] = ::operator new(48 + i));
+    for (int i = 0; i < 64; ++i)
+      ::operator delete(blocks[i]);
+  });
+
+  AddFunctor<1> add1;
+  AddFunctor<2> add2;
+  AddFunctor<3> add3;
+  std::vector<Functor<uint32_t, uint32_t> *> chain;
+  for (int i = 0; i < 64; ++i) {
+    Functor<uint32_t, uint32_t> *functors[] = {&add1, &add2, &add3};
+    chain.push_back(functors[(i * 7) % 3]);
+  }
+  harness.add("functor/dispatch_x64", [&chain] {
+    uint32_t value = 0;
+    for (auto *functor : chain)
+      value = (*functor)(value);
+    doNotOptimize(value);
+  });
+
+  if (!frameMapMoveAssignment()) {
+    std::cerr << "FrameHashMap move assignment across arenas is broken"
+              << std::endl;
+    return 1;
+  }
+
+  // descriptor lookups: structural hash vs std::hash on the same keys
+  std::vector<ImageData> descriptors;
+  for (uint32_t i = 0; i < 1024; ++i)
+    descriptors.push_back({1920 + i, 1080, 1, i % 7, i % 3});
+  FlatHashMap<ImageData, uint32_t, Hash,
+              decltype([](const ImageData &a, const ImageData &b) {
+                return hashFields(a) == hashFields(b);
+              })>
+      flat;
+  std::unordered_map<std::string, uint32_t> names;
+  for (uint32_t i = 0; i < descriptors.size(); ++i) {
+    flat[descriptors[i]] = i;
+    names["resource" + std::to_string(i)] = i;
+  }
+  FlatHashMap<std::string, uint32_t> flatNames;
+  for (const auto &[name, id] : names)
+    flatNames[name] = id;
+
+  harness.add("lookup/flat_descriptor", [&] {
+    uint32_t sum = 0;
+    for (const auto &d : descriptors)
+      sum += flat.find(d)->second;
+    doNotOptimize(sum);
+  });
+  harness.add("lookup/flat_string", [&] {
+    uint32_t sum = 0;
+    for (const auto &[name, id] : names)
+      sum += flatNames.find(name)->second;
+    doNotOptimize(sum);
+  });
+  harness.add("lookup/std_unordered_string", [&] {
+    uint32_t sum = 0;
+    for (const auto &[name, id] : names)
+      sum += names.find(name)->second;
+    doNotOptimize(sum);
+  });
+
+  // lighting -> post at 1080p, the intermediate written and read back in
+  // full versus kept in a tile, see graph/fusion.cpp
+  PassGraph lightingChain;
+  {
+    std::size_t pixels = 1920 * 1080;
+    ResourceId albedo = lightingChain.addResource("albedo", pixels);
+    ResourceId normal = lightingChain.addResource("normal", pixels);
+    ResourceId lightMap = lightingChain.addResource("lightMap", pixels);
+    ResourceId post = lightingChain.addResource("post", pixels);
+    lightingChain.addPass("lighting", PassKind::PerElement, {albedo, normal},
+                   {lightMap}, [](auto in, auto out, std::size_t count) {
+                     for (std::size_t i = 0; i < count; ++i)
+                       out[0][i] = in[0][i] * std::max(0.0f, in[1][i]);
+                   });
+    lightingChain.addPass("post", PassKind::PerElement, {lightMap}, {post},
+                   [](auto in, auto out, std::size_t count) {
+                     for (std::size_t i = 0; i < count; ++i)
+                       out[0][i] = in[0][i] / (1.0f + in[0][i]);
+                   });
+    lightingChain.markOutput(post);
+  }
+  auto unfusedChain = lightingChain.compile(false);
+  auto fusedChain = lightingChain.compile();
+  harness.add("fusion/compile_and_allocate", [&lightingChain] {
+    auto compiled = lightingChain.compile();
+    doNotOptimize(compiled.report().bytesEliminated);
+  });
+  harness.add("fusion/lighting_post_unfused",
+              [&unfusedChain] { unfusedChain.execute(); });
+  harness.add("fusion/lighting_post_fused",
+              [&fusedChain] { fusedChain.execute(); });
+
+  // 16 frames with equal work per stage; with one core the stages only
+  // interleave, with three or more they overlap
+  auto stageWork = [](uint64_t seed) {
+    float value = static_cast<float>(seed);
+    for (int i = 0; i < 20000; ++i)
+      value = std::sin(value) + 1.0f;
+    return value;
+  };
+  for (uint32_t inFlight : {1u, 3u}) {
+    harness.add("pipeline/in_flight_" + std::to_string(inFlight) + "_x16",
+                [inFlight, stageWork] {
+                  FramePipeline<float, float> pipeline(
+                      inFlight,
+                      {[&](FrameContext &frame) {
+                         return stageWork(frame.index);
+                       },
+                       [&](FrameContext &, float &&v) { return stageWork(v); },
+                       [&](FrameContext &, float &&v) {
+                         doNotOptimize(stageWork(v));
+                       }});
+                  doNotOptimize(pipeline.run(16).frames);
+                });
+  }
+
+#if defined(GRAPH_TRACE)
+  // zones on the hot path, drained every batch so the buffer never drops
+  harness.add("trace/zone_x256_and_collect", [] {
+    for (int i = 0; i < 256; ++i) {
+      TRACE_ZONE("bench", "zone");
+    }
+    Tracer::instance().clear();
+  });
+  harness.add("trace/collect_empty", [] { Tracer::instance().clear(); });
+#endif
+
+  int status = harness.run(argc, argv);
+  NamingPool::release(); // its entries may live in one of the arenas
+  std::filesystem::remove_all(cacheDir);
+  return status;
+}
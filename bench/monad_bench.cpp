@@ -0,0 +1,64 @@
+#include <functional>
+#include <optional>
+
+#include "../graph/monad.hpp"
+#include "bench.hpp"
+
+int main(int argc, char *argv[]) {
+  Harness harness("monad");
+
+  function<int(int)> inc = [](int x) { return x + 1; };
+  function<std::optional<int>(int)> incOptional =
+      [](int x) -> std::optional<int> { return x + 1; };
+  function<Optional<int>(int)> incCompact = [](int x) -> Optional<int> {
+    return x + 1;
+  };
+  function<Identity<int>(int)> incIdentity = [](int x) {
+    return Identity<int>(x + 1);
+  };
+
+  harness.add("bind/std_optional_x16", [&] {
+    auto m = unit<std::optional, int>(0);
+    for (int i = 0; i < 16; ++i)
+      m = bind<std::optional, int, int>(m, incOptional);
+    doNotOptimize(m);
+  });
+
+  harness.add("bind/compact_optional_x16", [&] {
+    auto m = unit<Optional, int>(0);
+    for (int i = 0; i < 16; ++i)
+      m = bind<Optional, int, int>(m, incCompact);
+    doNotOptimize(m);
+  });
+
+  harness.add("bind/identity_x16", [&] {
+    auto m = unit<Identity, int>(0);
+    for (int i = 0; i < 16; ++i)
+      m = bind<Identity, int, int>(m, incIdentity);
+    doNotOptimize(m);
+  });
+
+  harness.add("bind/nothing_x16", [&] {
+    std::optional<int> m;
+    for (int i = 0; i < 16; ++i)
+      m = bind<std::optional, int, int>(m, incOptional);
+    doNotOptimize(m);
+  });
+
+  harness.add("fmap/std_optional_x16", [&] {
+    auto m = unit<std::optional, int>(0);
+    for (int i = 0; i < 16; ++i)
+      m = fmap<std::optional, int, int>(m, inc);
+    doNotOptimize(m);
+  });
+
+  // baseline: the same chain without the monad plumbing
+  harness.add("baseline/plain_x16", [&] {
+    int x = 0;
+    for (int i = 0; i < 16; ++i)
+      x = inc(x);
+    doNotOptimize(x);
+  });
+
+  return harness.run(argc, argv);
+}
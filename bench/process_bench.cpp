@@ -0,0 +1,65 @@
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../graph/process_graph.hpp"
+#include "bench.hpp"
+
+// wide pass DAG: independent passes write a slice each, one pass reduces them;
+// the speedup over workers_1 is bounded by hardware_concurrency
+void buildWide(ProcessGraph &graph, uint32_t width, std::size_t floats) {
+  std::vector<ResourceId> slices;
+  for (uint32_t i = 0; i < width; ++i) {
+    slices.push_back(
+        graph.addResource("slice" + std::to_string(i), floats * sizeof(float)));
+    graph.addPass("simulate" + std::to_string(i), {}, {slices.back()},
+                  [i](PassContext &context) {
+                    auto out = context.output<float>(0);
+                    for (std::size_t k = 0; k < out.size(); ++k)
+                      out[k] = std::sin(0.001f * k + i) * std::cos(0.002f * k);
+                  });
+  }
+  ResourceId sum = graph.addResource("sum", sizeof(double));
+  graph.addPass("reduce", slices, {sum}, [width](PassContext &context) {
+    double total = 0;
+    for (uint32_t i = 0; i < width; ++i)
+      for (float v : context.input<float>(i))
+        total += v;
+    context.output<double>(0)[0] = total;
+  });
+}
+
+int main(int argc, char *argv[]) {
+  Harness harness("process");
+
+  // workers are forked by the first call of each body, after the harness
+  // opened its counters, so they inherit them; this suite starts no threads,
+  // fork() stays safe
+  ProcessGraph wide;
+  buildWide(wide, 16, 1 << 18);
+  std::vector<std::unique_ptr<ProcessExecutor>> executors(4);
+  for (uint32_t i = 0; i < executors.size(); ++i) {
+    uint32_t workers = 1u << i;
+    harness.add("scaling/workers_" + std::to_string(workers),
+                [&executor = executors[i], &wide, workers] {
+                  if (!executor)
+                    executor = std::make_unique<ProcessExecutor>(wide, workers);
+                  doNotOptimize(executor->run().ms);
+                });
+  }
+
+  // coordinator round trip: one message each way per pass
+  ProcessGraph empty;
+  for (uint32_t i = 0; i < 64; ++i)
+    empty.addPass("empty" + std::to_string(i), {}, {}, [](PassContext &) {});
+  std::unique_ptr<ProcessExecutor> dispatcher;
+  harness.add("dispatch/empty_pass_x64", [&dispatcher, &empty] {
+    if (!dispatcher)
+      dispatcher = std::make_unique<ProcessExecutor>(empty, 1);
+    doNotOptimize(dispatcher->run().ms);
+  });
+
+  return harness.run(argc, argv);
+}
@@ -0,0 +1,58 @@
+#include <numeric>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+int main(int argc, char *argv[]) {
+  using namespace std::ranges;
+  Harness harness("ranges");
+
+  std::vector<int> values(4096);
+  std::iota(values.begin(), values.end(), 0);
+
+  // the pipeline from ranges/view.cpp, minus the string conversion
+  harness.add("view/filter_transform_drop", [&values] {
+    long sum = 0;
+    for (int v : values | views::filter([](int a) { return a % 2 == 0; }) |
+                     views::transform([](int a) { return a * 2; }) |
+                     views::drop(2))
+      sum += v;
+    doNotOptimize(sum);
+  });
+
+  harness.add("baseline/filter_transform_drop", [&values] {
+    long sum = 0;
+    int skipped = 0;
+    for (int a : values) {
+      if (a % 2 != 0)
+        continue;
+      if (skipped < 2) {
+        ++skipped;
+        continue;
+      }
+      sum += a * 2;
+    }
+    doNotOptimize(sum);
+  });
+
+  harness.add("view/to_string_x64", [&values] {
+    for (auto s : values | views::take(64) |
+                      views::transform([](int a) { return std::to_string(a); }))
+      doNotOptimize(s);
+  });
+
+  harness.add("view/split_words", [] {
+    static const std::string text =
+        "This is a string that the split view walks word by word.";
+    int words = 0;
+    for (auto word : text | views::split(' ')) {
+      doNotOptimize(word);
+      ++words;
+    }
+    doNotOptimize(words);
+  });
+
+  return harness.run(argc, argv);
+}
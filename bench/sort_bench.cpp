@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#ifdef SORT_BENCH_PARALLEL_STL
+#include <execution>
+#endif
+
+#include "../ranges/sort.hpp"
+#include "bench.hpp"
+
+// 1M keys of each kind, every run sorts a fresh copy; copy/* is the part of
+// each time that is not sorting
+
+constexpr std::size_t count = 1 << 20;
+
+// interleaves the low 10 bits of x, y, z
+uint32_t morton(uint32_t x, uint32_t y, uint32_t z) {
+  auto spread = [](uint32_t v) {
+    v &= 0x3ff;
+    v = (v | v << 16) & 0x030000ff;
+    v = (v | v << 8) & 0x0300f00f;
+    v = (v | v << 4) & 0x030c30c3;
+    v = (v | v << 2) & 0x09249249;
+    return v;
+  };
+  return spread(x) | spread(y) << 1 | spread(z) << 2;
+}
+
+int main(int argc, char *argv[]) {
+  Harness harness("sort");
+
+  std::mt19937_64 rng(42);
+  std::vector<uint32_t> keys(count), passIds(count), mortons(count);
+  std::vector<float> floats(count);
+  std::vector<uint64_t> wide(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    keys[i] = static_cast<uint32_t>(rng());
+    passIds[i] = keys[i] & 0xffff;
+    mortons[i] = morton(rng() % 1024, rng() % 1024, rng() % 1024);
+    floats[i] = std::uniform_real_distribution<float>(-1e3f, 1e3f)(rng);
+    wide[i] = rng();
+  }
+  std::vector<uint32_t> values(count);
+  for (std::size_t i = 0; i < count; ++i)
+    values[i] = static_cast<uint32_t>(i);
+
+  std::vector<uint32_t> work;
+  std::vector<float> workFloats;
+  std::vector<uint64_t> workWide;
+  std::vector<uint32_t> workValues;
+
+  harness.add("copy/u32_1M", [&] {
+    work = keys;
+    doNotOptimize(work.data());
+  });
+
+  harness.add("std_sort/u32_1M", [&] {
+    work = keys;
+    std::sort(work.begin(), work.end());
+    doNotOptimize(work.data());
+  });
+#ifdef SORT_BENCH_PARALLEL_STL
+  harness.add("std_par_sort/u32_1M", [&] {
+    work = keys;
+    std::sort(std::execution::par, work.begin(), work.end());
+    doNotOptimize(work.data());
+  });
+#endif
+  harness.add("radix/u32_1M", [&] {
+    work = keys;
+    radixSort(work);
+    doNotOptimize(work.data());
+  });
+  harness.add("merge/u32_1M", [&] {
+    work = keys;
+    mergeSort(work);
+    doNotOptimize(work.data());
+  });
+
+  // pass ids below 65536: the two high bytes are skipped
+  harness.add("radix/pass_id_1M", [&] {
+    work = passIds;
+    radixSort(work);
+    doNotOptimize(work.data());
+  });
+
+  // 30 bit Morton codes of BVH primitives
+  harness.add("std_sort/morton_1M", [&] {
+    work = mortons;
+    std::sort(work.begin(), work.end());
+    doNotOptimize(work.data());
+  });
+  harness.add("radix/morton_1M", [&] {
+    work = mortons;
+    radixSort(work);
+    doNotOptimize(work.data());
+  });
+
+  harness.add("std_sort/f32_1M", [&] {
+    workFloats = floats;
+    std::sort(workFloats.begin(), workFloats.end());
+    doNotOptimize(workFloats.data());
+  });
+#ifdef SORT_BENCH_PARALLEL_STL
+  harness.add("std_par_sort/f32_1M", [&] {
+    workFloats = floats;
+    std::sort(std::execution::par, workFloats.begin(), workFloats.end());
+    doNotOptimize(workFloats.data());
+  });
+#endif
+  harness.add("radix/f32_1M", [&] {
+    workFloats = floats;
+    radixSort(workFloats);
+    doNotOptimize(workFloats.data());
+  });
+
+  harness.add("std_sort/u64_1M", [&] {
+    workWide = wide;
+    std::sort(workWide.begin(), workWide.end());
+    doNotOptimize(workWide.data());
+  });
+  harness.add("radix/u64_1M", [&] {
+    workWide = wide;
+    radixSort(workWide);
+    doNotOptimize(workWide.data());
+  });
+
+  // key-value: sorting pairs is what the separate value array replaces
+  std::vector<std::pair<uint32_t, uint32_t>> pairs(count), workPairs;
+  for (std::size_t i = 0; i < count; ++i)
+    pairs[i] = {keys[i], values[i]};
+  harness.add("std_stable_sort/pairs_1M", [&] {
+    workPairs = pairs;
+    std::stable_sort(workPairs.begin(), workPairs.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.first < b.first;
+                     });
+    doNotOptimize(workPairs.data());
+  });
+  harness.add("radix_by_key/u32_u32_1M", [&] {
+    work = keys;
+    workValues = values;
+    radixSortByKey(work, workValues);
+    doNotOptimize(workValues.data());
+  });
+  harness.add("merge_by_key/u32_u32_1M", [&] {
+    work = keys;
+    workValues = values;
+    mergeSortByKey(work, workValues);
+    doNotOptimize(workValues.data());
+  });
+
+  return harness.run(argc, argv);
+}
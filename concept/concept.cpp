@@ -2,6 +2,8 @@
 #include <iostream>
 #include <type_traits>
 
+#include "../others/hash.hpp"
+
 template <typename T>
 concept Addable = requires(T t) {
   t + t;
@@ -22,4 +24,28 @@ template <typename T>
 requires Outputable<T> && Hashable<T> && Addable<T>
 void f(T a) { std::cout << a << " -> " << std::hash<T>{}(a) << std::endl; }
 
-int main() { f(42); }
+// fields are described once, FastHashable picks them up through hashFields()
+struct Extent {
+  unsigned width;
+  unsigned height;
+};
+auto hashFields(const Extent &e) { return std::tie(e.width, e.height); }
+
+// padding free, but the generation counter is not part of its identity
+struct Handle {
+  uint32_t index;
+  uint32_t generation;
+};
+auto hashFields(const Handle &h) { return std::tie(h.index); }
+
+template <FastHashable T> void g(const T &a) {
+  std::cout << "hashValue -> " << hashValue(a) << std::endl;
+}
+
+int main() {
+  f(42);
+  g(Extent{1920, 1080});
+  g(std::string("colorMap"));
+  g(Handle{7, 1});
+  g(Handle{7, 2});
+}
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../others/optional.hpp"
+
+// Bounded multi producer / multi consumer channel for coroutines.
+//
+// 1. the buffer is a lock-free ring (Vyukov): every cell carries a sequence
+//    number, senders and receivers claim cells with one CAS on their cursor,
+//    so the fast path of send/recv takes no lock;
+// 2. co_await send() on a full channel, or recv() on an empty one, suspends
+//    the coroutine and parks it in a waiter list guarded by a spinlock; the
+//    lock is only taken when somebody has to wait or has to be woken;
+// 3. whoever frees a cell (or fills one) hands work over to the waiters
+//    directly: the waker moves items out of a waiting sender's batch, or into
+//    a waiting receiver's buffer, and resumes it on its own thread;
+// 4. close() fails pending and future sends, receivers drain what is left
+//    and then get nothing.
+//
+// Lost wakeups: a waiter registers, then retries under the lock; a waker
+// publishes its item, then checks the waiter count. A seq_cst fence on both
+// sides makes sure at least one of them sees the other.
+template <typename T>
+class Channel
+{
+public:
+    explicit Channel(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity)
+            size *= 2;
+        mask_ = size - 1;
+        cells_ = std::make_unique<Cell[]>(size);
+        for (std::size_t i = 0; i < size; ++i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    ~Channel()
+    {
+        T item;
+        while (tryPop(item))
+        {
+        }
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    // non blocking, false when full or closed
+    bool trySend(T &item)
+    {
+        if (closed() || !tryPush(item))
+            return false;
+        wakeReceivers();
+        return true;
+    }
+
+    // non blocking, nothing when empty
+    Optional<T> tryRecv()
+    {
+        T item;
+        if (!tryPop(item))
+            return {};
+        wakeSenders();
+        return Optional<T>(std::move(item));
+    }
+
+    class SendAwaiter;
+    class SendOneAwaiter;
+    class RecvAwaiter;
+    class RecvOneAwaiter;
+
+    // co_await: true once sent, false when the channel is closed first
+    SendOneAwaiter send(T item) { return SendOneAwaiter(*this, std::move(item)); }
+
+    // co_await: the number of items sent, all of them unless closed
+    SendAwaiter sendBatch(std::span<T> items) { return SendAwaiter(*this, items); }
+
+    // co_await: the next item, nothing once closed and drained
+    RecvOneAwaiter recv() { return RecvOneAwaiter(*this); }
+
+    // co_await: between 1 and out.size() items, 0 once closed and drained
+    RecvAwaiter recvBatch(std::span<T> out) { return RecvAwaiter(*this, out); }
+
+    void close()
+    {
+        std::vector<std::coroutine_handle<>> wake;
+        lock();
+        closed_.store(true, std::memory_order_release);
+        for (auto *w = senders_.first; w; w = w->next)
+            wake.push_back(w->handle);
+        senders_ = {};
+        // receivers take what is left, the rest of them wake up empty
+        for (auto *w = receivers_.first; w; w = w->next)
+        {
+            fill(*w);
+            wake.push_back(w->handle);
+        }
+        receivers_ = {};
+        sendWaiting_.store(0, std::memory_order_relaxed);
+        recvWaiting_.store(0, std::memory_order_relaxed);
+        unlock();
+        for (auto handle : wake)
+            handle.resume();
+    }
+
+private:
+    struct Waiter
+    {
+        std::coroutine_handle<> handle;
+        SendAwaiter *send = nullptr;
+        RecvAwaiter *recv = nullptr;
+        Waiter *next = nullptr;
+    };
+
+public:
+    class SendAwaiter
+    {
+    public:
+        SendAwaiter(Channel &channel, std::span<T> items) : channel_(channel), items_(items) {}
+
+        bool await_ready()
+        {
+            channel_.pushSome(*this);
+            return sent_ == items_.size() || channel_.closed();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            waiter_.handle = handle;
+            waiter_.send = this;
+            return channel_.park(waiter_, channel_.senders_, channel_.sendWaiting_);
+        }
+
+        std::size_t await_resume() { return sent_; }
+
+    protected:
+        friend class Channel;
+
+        Channel &channel_;
+        std::span<T> items_;
+        std::size_t sent_ = 0;
+        Waiter waiter_;
+    };
+
+    class SendOneAwaiter : public SendAwaiter
+    {
+    public:
+        SendOneAwaiter(Channel &channel, T item) : SendAwaiter(channel, {}), item_(std::move(item))
+        {
+            this->items_ = std::span<T>(&item_, 1);
+        }
+
+        bool await_resume() { return this->sent_ == 1; }
+
+    private:
+        T item_;
+    };
+
+    class RecvAwaiter
+    {
+    public:
+        RecvAwaiter(Channel &channel, std::span<T> out) : channel_(channel), out_(out) {}
+
+        bool await_ready()
+        {
+            channel_.popSome(*this);
+            return received_ > 0 || out_.empty() || channel_.closedAndEmpty();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            waiter_.handle = handle;
+            waiter_.recv = this;
+            return channel_.park(waiter_, channel_.receivers_, channel_.recvWaiting_);
+        }
+
+        std::size_t await_resume() { return received_; }
+
+    protected:
+        friend class Channel;
+
+        Channel &channel_;
+        std::span<T> out_;
+        std::size_t received_ = 0;
+        Waiter waiter_;
+    };
+
+    class RecvOneAwaiter : public RecvAwaiter
+    {
+    public:
+        explicit RecvOneAwaiter(Channel &channel) : RecvAwaiter(channel, {})
+        {
+            this->out_ = std::span<T>(&item_, 1);
+        }
+
+        Optional<T> await_resume()
+        {
+            if (this->received_ == 0)
+                return {};
+            return Optional<T>(std::move(item_));
+        }
+
+    private:
+        T item_{};
+    };
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    struct WaiterList
+    {
+        Waiter *first = nullptr;
+        Waiter *last = nullptr;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    std::size_t mask_;
+    alignas(64) std::atomic<std::size_t> tail_{0}; // next cell to send into
+    alignas(64) std::atomic<std::size_t> head_{0}; // next cell to receive from
+    alignas(64) std::atomic<bool> closed_{false};
+    std::atomic<uint32_t> sendWaiting_{0};
+    std::atomic<uint32_t> recvWaiting_{0};
+    std::atomic_flag spin_ = ATOMIC_FLAG_INIT;
+    WaiterList senders_;
+    WaiterList receivers_;
+
+    void lock()
+    {
+        while (spin_.test_and_set(std::memory_order_acquire))
+            while (spin_.test(std::memory_order_relaxed))
+                std::this_thread::yield();
+    }
+    void unlock() { spin_.clear(std::memory_order_release); }
+
+    bool tryPush(T &item)
+    {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(item);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; // full
+            else
+                pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPop(T &item)
+    {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = cells_[pos & mask_];
+            std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    item = std::move(cell.value);
+                    cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; // empty
+            else
+                pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool closedAndEmpty()
+    {
+        if (!closed())
+            return false;
+        std::size_t pos = head_.load(std::memory_order_acquire);
+        auto sequence = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+        return sequence != pos + 1;
+    }
+
+    // moves as much of a sender's batch into the ring as fits
+    bool pushSome(SendAwaiter &send)
+    {
+        std::size_t before = send.sent_;
+        while (send.sent_ < send.items_.size() && !closed() && tryPush(send.items_[send.sent_]))
+            ++send.sent_;
+        if (send.sent_ == before)
+            return false;
+        wakeReceivers();
+        return true;
+    }
+
+    // takes as many items as the receiver has room for
+    bool popSome(RecvAwaiter &recv)
+    {
+        std::size_t before = recv.received_;
+        while (recv.received_ < recv.out_.size() && tryPop(recv.out_[recv.received_]))
+            ++recv.received_;
+        if (recv.received_ == before)
+            return false;
+        wakeSenders();
+        return true;
+    }
+
+    // the lock-free parts of pushSome/popSome, used with the lock held
+    void fill(Waiter &w)
+    {
+        auto &recv = *w.recv;
+        while (recv.received_ < recv.out_.size() && tryPop(recv.out_[recv.received_]))
+            ++recv.received_;
+    }
+    void drain(Waiter &w)
+    {
+        auto &send = *w.send;
+        while (send.sent_ < send.items_.size() && tryPush(send.items_[send.sent_]))
+            ++send.sent_;
+    }
+
+    static void append(WaiterList &list, Waiter &w)
+    {
+        w.next = nullptr;
+        if (list.last)
+            list.last->next = &w;
+        else
+            list.first = &w;
+        list.last = &w;
+    }
+
+    static void popFront(WaiterList &list)
+    {
+        list.first = list.first->next;
+        if (!list.first)
+            list.last = nullptr;
+    }
+
+    // registers a waiter, false (do not suspend) when the retry succeeds
+    bool park(Waiter &w, WaiterList &list, std::atomic<uint32_t> &count)
+    {
+        const bool sending = w.send != nullptr; // w may be gone after unlock()
+        lock();
+        count.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool done, moved;
+        if (sending)
+        {
+            std::size_t before = w.send->sent_;
+            drain(w);
+            moved = w.send->sent_ != before;
+            done = w.send->sent_ == w.send->items_.size() || closed();
+        }
+        else
+        {
+            fill(w);
+            moved = w.recv->received_ > 0;
+            done = moved || closedAndEmpty();
+        }
+        if (done)
+            count.fetch_sub(1, std::memory_order_relaxed);
+        else
+            append(list, w);
+        unlock();
+        // the retry moved items, the other side may be waiting for them
+        if (moved && sending)
+            wakeReceivers();
+        else if (moved)
+            wakeSenders();
+        return !done;
+    }
+
+    // after items were published: hand them to waiting receivers
+    void wakeReceivers()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (recvWaiting_.load(std::memory_order_relaxed) == 0)
+            return;
+        std::vector<std::coroutine_handle<>> wake;
+        bool refilled = false;
+        lock();
+        while (receivers_.first)
+        {
+            Waiter &w = *receivers_.first;
+            fill(w);
+            if (w.recv->received_ == 0)
+                break;
+            refilled = true;
+            popFront(receivers_);
+            recvWaiting_.fetch_sub(1, std::memory_order_relaxed);
+            wake.push_back(w.handle);
+        }
+        unlock();
+        if (refilled)
+            wakeSenders(); // cells were freed on the receivers' behalf
+        for (auto handle : wake)
+            handle.resume();
+    }
+
+    // after cells were freed: move waiting senders' items in
+    void wakeSenders()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sendWaiting_.load(std::memory_order_relaxed) == 0)
+            return;
+        std::vector<std::coroutine_handle<>> wake;
+        bool pushed = false;
+        lock();
+        while (senders_.first)
+        {
+            Waiter &w = *senders_.first;
+            std::size_t before = w.send->sent_;
+            drain(w);
+            pushed |= w.send->sent_ != before;
+            if (w.send->sent_ < w.send->items_.size())
+                break; // ring full again, it stays first in line
+            popFront(senders_);
+            sendWaiting_.fetch_sub(1, std::memory_order_relaxed);
+            wake.push_back(w.handle);
+        }
+        unlock();
+        if (pushed)
+            wakeReceivers();
+        for (auto handle : wake)
+            handle.resume();
+    }
+};
@@ -0,0 +1,137 @@
+// decode -> transform -> encode, every stage a group of coroutines connected
+// by bounded channels; stages start on their own threads and from then on
+// run on whichever thread hands them work
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "channel.hpp"
+#include "task.hpp"
+
+struct Message
+{
+    uint32_t id = 0;
+    double value = 0;
+};
+
+constexpr uint32_t messages = 200000;
+constexpr std::size_t batch = 32;
+
+// one raw record per message, "id,value"
+Task source(Channel<std::string> &raw)
+{
+    std::vector<std::string> lines;
+    for (uint32_t id = 0; id < messages; ++id)
+    {
+        lines.push_back(std::to_string(id) + "," + std::to_string(id % 1000));
+        if (lines.size() == batch || id + 1 == messages)
+        {
+            co_await raw.sendBatch(lines);
+            lines.clear();
+        }
+    }
+    raw.close();
+}
+
+Task decode(Channel<std::string> &raw, Channel<Message> &decoded, std::atomic<int> &running)
+{
+    std::vector<std::string> lines(batch);
+    std::vector<Message> out;
+    while (std::size_t n = co_await raw.recvBatch(lines))
+    {
+        out.clear();
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const std::string &line = lines[i];
+            auto comma = line.find(',');
+            Message message;
+            std::from_chars(line.data(), line.data() + comma, message.id);
+            std::from_chars(line.data() + comma + 1, line.data() + line.size(), message.value);
+            out.push_back(message);
+        }
+        co_await decoded.sendBatch(out);
+    }
+    if (--running == 0) // the last decoder closes the next stage
+        decoded.close();
+}
+
+Task transform(Channel<Message> &decoded, Channel<Message> &transformed, std::atomic<int> &running)
+{
+    while (auto message = co_await decoded.recv())
+    {
+        message->value = std::sqrt(message->value) * 2.0;
+        co_await transformed.send(*message);
+    }
+    if (--running == 0)
+        transformed.close();
+}
+
+Task encode(Channel<Message> &transformed, uint64_t &count, double &sum, std::size_t &bytes)
+{
+    std::vector<Message> in(batch);
+    char buffer[64];
+    while (std::size_t n = co_await transformed.recvBatch(in))
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), in[i].value);
+            bytes += end - buffer;
+            sum += in[i].value;
+            ++count;
+        }
+    }
+}
+
+int main()
+{
+    Channel<std::string> raw(256);
+    Channel<Message> decoded(256);
+    Channel<Message> transformed(256);
+    std::atomic<int> decoders = 2;
+    std::atomic<int> transformers = 2;
+    uint64_t count = 0;
+    double sum = 0;
+    std::size_t bytes = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<Task> tasks;
+    std::vector<std::thread> threads;
+    std::atomic_flag guard = ATOMIC_FLAG_INIT; // tasks is shared by the threads
+    auto start = [&](auto make)
+    {
+        threads.emplace_back([&, make]
+        {
+            Task task = make();
+            while (guard.test_and_set())
+                std::this_thread::yield();
+            tasks.push_back(std::move(task));
+            guard.clear();
+        });
+    };
+    start([&] { return encode(transformed, count, sum, bytes); });
+    for (int i = 0; i < 2; ++i)
+        start([&] { return transform(decoded, transformed, transformers); });
+    for (int i = 0; i < 2; ++i)
+        start([&] { return decode(raw, decoded, decoders); });
+    start([&] { return source(raw); });
+    for (auto &thread : threads)
+        thread.join();
+    for (auto &task : tasks)
+        task.wait();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+    double expected = 0;
+    for (uint32_t id = 0; id < messages; ++id)
+        expected += std::sqrt(static_cast<double>(id % 1000)) * 2.0;
+    std::cout << count << " messages, " << bytes << " bytes encoded in " << ms << " ms ("
+              << count / ms * 1000.0 << " messages/s)" << std::endl;
+    bool ok = count == messages && std::abs(sum - expected) < 1e-6 * expected;
+    std::cout << (ok ? "checksum ok" : "checksum mismatch") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+// Eager coroutine: runs until its first suspension when called, then goes on
+// wherever it is resumed (for channel waiters, on the thread that woke it).
+// wait() blocks the calling thread until the coroutine has finished.
+class Task
+{
+public:
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        // shared with the final awaiter, which still notifies through it
+        // after the owner may have destroyed the frame
+        std::shared_ptr<std::atomic<bool>> done_ =
+            std::make_shared<std::atomic<bool>>(false);
+        std::exception_ptr exception_;
+
+        Task get_return_object() { return Task(handle_type::from_promise(*this)); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept
+        {
+            // flag it only once suspended, the owner may destroy the frame
+            // as soon as it sees the flag
+            struct Final
+            {
+                bool await_ready() noexcept { return false; }
+                void await_suspend(handle_type h) noexcept
+                {
+                    auto done = h.promise().done_;
+                    done->store(true, std::memory_order_release);
+                    done->notify_all();
+                }
+                void await_resume() noexcept {}
+            };
+            return Final{};
+        }
+        void unhandled_exception() { exception_ = std::current_exception(); }
+        void return_void() {}
+    };
+
+    Task(Task &&other) noexcept : h_(std::exchange(other.h_, {})) {}
+    Task &operator=(Task &&other) noexcept
+    {
+        std::swap(h_, other.h_);
+        return *this;
+    }
+    ~Task()
+    {
+        if (h_)
+        {
+            block();
+            h_.destroy();
+        }
+    }
+
+    bool done() const { return h_.promise().done_->load(std::memory_order_acquire); }
+
+    // waits for the end of the coroutine and rethrows what escaped it
+    void wait()
+    {
+        block();
+        if (h_.promise().exception_)
+            std::rethrow_exception(h_.promise().exception_);
+    }
+
+private:
+    explicit Task(handle_type h) : h_(h) {}
+
+    // sleeps on the flag instead of spinning on it
+    void block() const { h_.promise().done_->wait(false, std::memory_order_acquire); }
+
+    handle_type h_;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+/**
+ per frame allocation
+
+ 1. FrameArena is a monotonic memory_resource: allocation bumps a pointer,
+    deallocation is a no-op, reset() rewinds to the first chunk in O(1) and
+    keeps the chunks for the next frame;
+ 2. DoubleBufferedArena alternates two arenas, data of frame N stays valid
+    while frame N + 1 is built and is released when frame N + 2 starts;
+ 3. frameResource() is the resource the graph allocates names and
+    containers from, FrameScope points it at an arena for the current thread.
+
+ an arena is not thread safe, give every worker thread its own arena (and
+ its own FrameScope) instead of sharing one; that is what removes the
+ contention on the global heap.
+*/
+
+class FrameArena : public std::pmr::memory_resource {
+public:
+  explicit FrameArena(
+      std::size_t chunkSize = 64 * 1024,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : chunkSize_(chunkSize), upstream_(upstream) {}
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  ~FrameArena() override { release(); }
+
+  // everything allocated since the last reset is gone, chunks are kept
+  void reset() {
+    current_ = first_;
+    cursor_ = current_ ? current_->begin() : nullptr;
+    used_ = 0;
+  }
+
+  // reset and hand every chunk back to the upstream resource
+  void release() {
+    while (first_) {
+      Chunk *next = first_->next;
+      upstream_->deallocate(first_, first_->size, alignof(Chunk));
+      first_ = next;
+    }
+    current_ = nullptr;
+    cursor_ = nullptr;
+    used_ = capacity_ = 0;
+  }
+
+  std::size_t used() const { return used_; }
+  std::size_t capacity() const { return capacity_; }
+  std::size_t highWater() const { return highWater_; }
+
+protected:
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+    for (;;) {
+      if (current_) {
+        auto p = reinterpret_cast<uintptr_t>(cursor_);
+        auto aligned = (p + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        if (aligned + bytes <= reinterpret_cast<uintptr_t>(current_->end())) {
+          used_ += aligned + bytes - p;
+          highWater_ = std::max(highWater_, used_);
+          cursor_ = reinterpret_cast<std::byte *>(aligned + bytes);
+          return reinterpret_cast<void *>(aligned);
+        }
+      }
+      nextChunk(bytes + alignment);
+    }
+  }
+
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+  bool do_is_equal(const memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct alignas(std::max_align_t) Chunk {
+    Chunk *next;
+    std::size_t size; // including this header
+
+    std::byte *begin() { return reinterpret_cast<std::byte *>(this + 1); }
+    std::byte *end() { return reinterpret_cast<std::byte *>(this) + size; }
+  };
+
+  std::size_t chunkSize_;
+  std::pmr::memory_resource *upstream_;
+  Chunk *first_ = nullptr;
+  Chunk *current_ = nullptr;
+  std::byte *cursor_ = nullptr;
+  std::size_t used_ = 0;
+  std::size_t capacity_ = 0;
+  std::size_t highWater_ = 0;
+
+  // move on to the next kept chunk, or grow the list when none is big enough
+  void nextChunk(std::size_t minimum) {
+    Chunk **link = current_ ? &current_->next : &first_;
+    while (*link && (*link)->size - sizeof(Chunk) < minimum)
+      link = &(*link)->next;
+    if (!*link) {
+      std::size_t size = std::max(chunkSize_, minimum + sizeof(Chunk));
+      void *memory = upstream_->allocate(size, alignof(Chunk));
+      *link = ::new (memory) Chunk{nullptr, size};
+      capacity_ += size;
+      chunkSize_ *= 2; // fewer, bigger chunks as the frame grows
+    }
+    current_ = *link;
+    cursor_ = current_->begin();
+  }
+};
+
+// frame N allocates from one arena while frame N - 1 may still be read
+class DoubleBufferedArena {
+  FrameArena arenas_[2];
+  std::size_t current_ = 0;
+
+public:
+  explicit DoubleBufferedArena(std::size_t chunkSize = 64 * 1024)
+      : arenas_{FrameArena(chunkSize), FrameArena(chunkSize)} {}
+
+  FrameArena &current() { return arenas_[current_]; }
+  FrameArena &previous() { return arenas_[current_ ^ 1]; }
+
+  // start a new frame: the arena of two frames ago is reset and becomes
+  // current, the last frame's data stays alive in previous()
+  FrameArena &flip() {
+    current_ ^= 1;
+    arenas_[current_].reset();
+    return arenas_[current_];
+  }
+};
+
+// the resource graph names and containers are allocated from on this thread
+inline std::pmr::memory_resource *&frameResource() {
+  thread_local std::pmr::memory_resource *resource =
+      std::pmr::get_default_resource();
+  return resource;
+}
+
+class FrameScope {
+  std::pmr::memory_resource *previous_;
+
+public:
+  explicit FrameScope(std::pmr::memory_resource &resource)
+      : previous_(std::exchange(frameResource(), &resource)) {}
+  ~FrameScope() { frameResource() = previous_; }
+  FrameScope(const FrameScope &) = delete;
+  FrameScope &operator=(const FrameScope &) = delete;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "../others/hash.hpp"
+
+/**
+ pass cache keys and entry encoding, portable
+
+ the parts of the pass cache that graph.hpp needs without POSIX: the 128 bit
+ key of a pass run and the CacheCodec serialization of pass outputs; the
+ cache directory itself is PassCache in pass_cache.hpp.
+*/
+
+struct CacheKey {
+  uint64_t hi;
+  uint64_t lo;
+
+  std::string hex() const {
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%016llx%016llx",
+                  static_cast<unsigned long long>(hi),
+                  static_cast<unsigned long long>(lo));
+    return buffer;
+  }
+};
+
+// serialization of pass outputs into cache entries, specialize for new types;
+// bump cacheFormat when an encoding changes, it is part of every key
+constexpr uint64_t cacheFormat = 2;
+
+template <typename T, typename = void> struct CacheCodec;
+
+// the next size bytes of in, throws when the entry ends before them
+inline std::span<const std::byte> cacheTake(std::span<const std::byte> &in,
+                                            std::size_t size) {
+  if (in.size() < size)
+    throw std::runtime_error("CacheCodec: truncated entry");
+  auto bytes = in.first(size);
+  in = in.subspan(size);
+  return bytes;
+}
+
+template <typename T>
+struct CacheCodec<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+  static void write(std::vector<std::byte> &out, const T &value) {
+    auto p = reinterpret_cast<const std::byte *>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+  }
+  static T read(std::span<const std::byte> &in) {
+    T value;
+    std::memcpy(&value, cacheTake(in, sizeof(T)).data(), sizeof(T));
+    return value;
+  }
+};
+
+template <typename... Ts> struct CacheCodec<std::tuple<Ts...>> {
+  static void write(std::vector<std::byte> &out,
+                    const std::tuple<Ts...> &value) {
+    std::apply([&out](const auto &...element) {
+      (CacheCodec<std::remove_cvref_t<decltype(element)>>::write(out, element),
+       ...);
+    }, value);
+  }
+  static std::tuple<Ts...> read(std::span<const std::byte> &in) {
+    // braced init keeps the elements in order
+    return std::tuple<Ts...>{CacheCodec<Ts>::read(in)...};
+  }
+};
+
+template <typename T> std::vector<std::byte> encodeCacheEntry(const T &value) {
+  std::vector<std::byte> out;
+  CacheCodec<T>::write(out, value);
+  return out;
+}
+
+// throws when in is not exactly one encoded T
+template <typename T> T decodeCacheEntry(std::span<const std::byte> in) {
+  T value = CacheCodec<T>::read(in);
+  if (!in.empty())
+    throw std::runtime_error("CacheCodec: trailing bytes in entry");
+  return value;
+}
+
+// a pass bumps its static cacheVersion when its kernel changes, which
+// retires the outputs cached under the old one; passes without one are 0
+template <typename Pass> constexpr uint64_t passCacheVersion() {
+  if constexpr (requires { Pass::cacheVersion; })
+    return Pass::cacheVersion;
+  else
+    return 0;
+}
+
+// the pass identity, its cache version and its input content hashed twice
+// with independent seeds, one run per half; halves derived from a single 64
+// bit content hash would collide together
+template <typename Pass, typename Input>
+CacheKey passCacheKey(const Input &input) {
+  std::string_view identity = typeid(Pass).name();
+  constexpr uint64_t version = passCacheVersion<Pass>();
+  constexpr uint64_t seedHi = 0x9e3779b97f4a7c15ull ^ cacheFormat;
+  constexpr uint64_t seedLo = 0xc2b2ae3d27d4eb4full ^ cacheFormat;
+  uint64_t hi = hashCombine(hashValue(identity, seedHi), version);
+  uint64_t lo = hashCombine(hashValue(identity, seedLo), version);
+  return {hashCombine(hi, contentHash(input, seedHi)),
+          hashCombine(lo, contentHash(input, seedLo))};
+}
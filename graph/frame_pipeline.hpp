@@ -0,0 +1,241 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../others/optional.hpp"
+#include "arena.hpp"
+
+/**
+ frames in flight
+
+ 1. a frame goes through three stages, record -> compile -> execute, each
+    stage runs on its own thread, so frame N executes while frame N + 1
+    compiles and frame N + 2 records;
+ 2. at most framesInFlight frames are between record and the end of execute;
+    a frame owns slot index % framesInFlight for its whole life, the slot
+    holds its FrameArena and its version of every Versioned<T>;
+ 3. the recorder waits for a free slot before it starts a frame: when the
+    executor falls behind, recording stalls instead of overwriting the inputs
+    of a frame that still executes (backpressure);
+ 4. the queues between stages are bounded as well, the stalls are counted
+    in PipelineStats.
+
+ a frame is touched by one stage at a time, handing it over through a queue
+ orders the accesses, so the per frame arena needs no locking.
+*/
+
+template <typename T> class BoundedQueue {
+  std::mutex mutex_;
+  std::condition_variable notEmpty_;
+  std::condition_variable notFull_;
+  std::deque<T> items_;
+  std::size_t capacity_;
+  bool closed_ = false;
+
+public:
+  explicit BoundedQueue(std::size_t capacity) : capacity_(capacity) {}
+
+  // blocks while full, false once closed
+  bool push(T item, uint64_t *stalls = nullptr) {
+    std::unique_lock lock(mutex_);
+    if (items_.size() >= capacity_ && !closed_ && stalls)
+      ++*stalls;
+    notFull_.wait(lock, [&] { return items_.size() < capacity_ || closed_; });
+    if (closed_)
+      return false;
+    items_.push_back(std::move(item));
+    notEmpty_.notify_one();
+    return true;
+  }
+
+  // blocks while empty, nothing once closed and drained
+  Optional<T> pop(uint64_t *stalls = nullptr) {
+    std::unique_lock lock(mutex_);
+    if (items_.empty() && !closed_ && stalls)
+      ++*stalls;
+    notEmpty_.wait(lock, [&] { return !items_.empty() || closed_; });
+    if (items_.empty())
+      return {};
+    Optional<T> item(std::move(items_.front()));
+    items_.pop_front();
+    notFull_.notify_one();
+    return item;
+  }
+
+  void close() {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+  }
+};
+
+struct FrameContext {
+  uint64_t index;
+  uint32_t slot;
+  FrameArena *arena;
+};
+
+// one version of T per frame slot
+template <typename T> class Versioned {
+  std::vector<T> versions_;
+
+public:
+  template <typename... Args>
+  explicit Versioned(uint32_t framesInFlight, const Args &...args) {
+    versions_.reserve(framesInFlight);
+    for (uint32_t i = 0; i < framesInFlight; ++i)
+      versions_.emplace_back(args...);
+  }
+
+  T &operator[](const FrameContext &frame) { return versions_[frame.slot]; }
+  const T &operator[](const FrameContext &frame) const {
+    return versions_[frame.slot];
+  }
+};
+
+struct PipelineStats {
+  uint64_t frames = 0;
+  double ms = 0;
+  double recordMs = 0;
+  double compileMs = 0;
+  double executeMs = 0;
+  uint64_t slotStalls = 0;    // recorder waited for a frame to retire
+  uint64_t compileStalls = 0; // compile queue was full
+  uint64_t executeStalls = 0; // execute queue was full
+
+  double framesPerSecond() const { return ms > 0 ? frames * 1000.0 / ms : 0; }
+};
+
+template <typename Recorded, typename Compiled> class FramePipeline {
+public:
+  struct Stages {
+    std::function<Recorded(FrameContext &)> record;
+    std::function<Compiled(FrameContext &, Recorded &&)> compile;
+    std::function<void(FrameContext &, Compiled &&)> execute;
+  };
+
+  FramePipeline(uint32_t framesInFlight, Stages stages)
+      : framesInFlight_(framesInFlight), stages_(std::move(stages)) {
+    if (framesInFlight == 0)
+      throw std::invalid_argument("FramePipeline needs a frame in flight");
+    for (uint32_t i = 0; i < framesInFlight; ++i)
+      arenas_.push_back(std::make_unique<FrameArena>());
+  }
+
+  uint32_t framesInFlight() const { return framesInFlight_; }
+  FrameArena &arena(uint32_t slot) { return *arenas_.at(slot); }
+
+  // runs frames [0, count), rethrows the first exception of any stage
+  PipelineStats run(uint64_t count) {
+    using Clock = std::chrono::steady_clock;
+    auto since = [](Clock::time_point begin) {
+      return std::chrono::duration<double, std::milli>(Clock::now() - begin)
+          .count();
+    };
+
+    PipelineStats stats;
+    BoundedQueue<uint32_t> freeSlots(framesInFlight_);
+    for (uint32_t slot = 0; slot < framesInFlight_; ++slot)
+      freeSlots.push(slot);
+    BoundedQueue<InFlight<Recorded>> recorded(1);
+    BoundedQueue<InFlight<Compiled>> compiled(1);
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto fail = [&] {
+      std::lock_guard lock(errorMutex);
+      if (!error)
+        error = std::current_exception();
+      freeSlots.close();
+      recorded.close();
+      compiled.close();
+    };
+
+    auto begin = Clock::now();
+    std::thread compiler([&] {
+      try {
+        while (auto frame = recorded.pop()) {
+          auto start = Clock::now();
+          FrameScope scope(*frame->context.arena);
+          InFlight<Compiled> next{
+              frame->context,
+              stages_.compile(frame->context, std::move(frame->value))};
+          stats.compileMs += since(start);
+          if (!compiled.push(std::move(next), &stats.executeStalls))
+            return;
+        }
+        compiled.close();
+      } catch (...) {
+        fail();
+      }
+    });
+    std::thread executor([&] {
+      try {
+        while (auto frame = compiled.pop()) {
+          auto start = Clock::now();
+          {
+            FrameScope scope(*frame->context.arena);
+            stages_.execute(frame->context, std::move(frame->value));
+          }
+          stats.executeMs += since(start);
+          ++stats.frames;
+          uint32_t slot = frame->context.slot;
+          frame.reset(); // the frame's data goes before its slot is reused
+          if (!freeSlots.push(slot))
+            return;
+        }
+      } catch (...) {
+        fail();
+      }
+    });
+
+    // the calling thread records
+    try {
+      for (uint64_t index = 0; index < count; ++index) {
+        auto slot = freeSlots.pop(&stats.slotStalls);
+        if (!slot)
+          break;
+        auto start = Clock::now();
+        FrameArena &arena = *arenas_[*slot];
+        arena.reset();
+        FrameContext context{index, *slot, &arena};
+        FrameScope scope(arena);
+        InFlight<Recorded> next{context, stages_.record(context)};
+        stats.recordMs += since(start);
+        if (!recorded.push(std::move(next), &stats.compileStalls))
+          break;
+      }
+      recorded.close();
+    } catch (...) {
+      fail();
+    }
+    compiler.join();
+    executor.join();
+    stats.ms = since(begin);
+    if (error)
+      std::rethrow_exception(error);
+    return stats;
+  }
+
+private:
+  template <typename T> struct InFlight {
+    FrameContext context;
+    T value;
+  };
+
+  uint32_t framesInFlight_;
+  Stages stages_;
+  std::vector<std::unique_ptr<FrameArena>> arenas_;
+};
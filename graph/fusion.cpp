@@ -0,0 +1,89 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "graph.hpp"
+#include "pass_graph.hpp"
+
+// the lighting -> post processing chain of main.cpp at 4K with real pixels;
+// lightMap has one reader, so compile() fuses the two passes and lightMap
+// only ever exists one tile at a time
+
+constexpr ImageData frame{3840, 2160, 1, 0, 0};
+
+ResourceId image(PassGraph &graph, std::string_view name) {
+  return graph.addResource(std::string(NamingPool::getName(name)),
+                           byteSize(frame) / sizeof(float));
+}
+
+void build(PassGraph &graph) {
+  ResourceId position = image(graph, "position");
+  ResourceId normal = image(graph, "normal");
+  ResourceId albedo = image(graph, "albedo");
+  ResourceId specular = image(graph, "specular");
+  ResourceId lightMap = image(graph, "lightMap");
+  ResourceId post = image(graph, "post");
+  ResourceId exposure = graph.addResource("exposure", 1);
+
+  graph.addPass("lighting", PassKind::PerElement,
+                {position, normal, albedo, specular}, {lightMap},
+                [](auto in, auto out, std::size_t count) {
+                  for (std::size_t i = 0; i < count; ++i) {
+                    float lambert = std::max(0.0f, in[1][i] - 0.2f * in[0][i]);
+                    out[0][i] =
+                        in[2][i] * lambert + in[3][i] * lambert * lambert;
+                  }
+                });
+  graph.addPass("post", PassKind::PerElement, {lightMap}, {post},
+                [](auto in, auto out, std::size_t count) {
+                  for (std::size_t i = 0; i < count; ++i)
+                    out[0][i] = in[0][i] / (1.0f + in[0][i]); // reinhard
+                });
+  // a reduction sees the whole image and is never fused
+  graph.addPass("exposure", PassKind::Global, {post}, {exposure},
+                [](auto in, auto out, std::size_t count) {
+                  double sum = 0;
+                  for (std::size_t i = 0; i < count; ++i)
+                    sum += in[0][i];
+                  out[0][0] = static_cast<float>(sum / count);
+                });
+  graph.markOutput(post);
+  graph.markOutput(exposure);
+}
+
+double run(CompiledGraph &compiled, const PassGraph &graph) {
+  // the G-buffer inputs, filled in place
+  for (ResourceId r = 0; r < 4; ++r) {
+    auto data = compiled.buffer(r);
+    for (std::size_t i = 0; i < data.size(); ++i)
+      data[i] = 0.5f + 0.5f * std::sin(0.001f * i * (r + 1));
+  }
+  auto begin = std::chrono::steady_clock::now();
+  compiled.execute();
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - begin)
+                  .count();
+  std::cout << compiled.report() << std::endl;
+  std::cout << "exposure " << compiled.buffer(graph.resources().size() - 1)[0]
+            << ", " << ms << " ms" << std::endl;
+  return compiled.buffer(graph.resources().size() - 1)[0];
+}
+
+int main() {
+  PassGraph graph;
+  build(graph);
+
+  std::cout << "unfused" << std::endl;
+  auto plain = graph.compile(false);
+  double expected = run(plain, graph);
+
+  std::cout << "fused" << std::endl;
+  auto fused = graph.compile();
+  double result = run(fused, graph);
+
+  NamingPool::release();
+  bool same = std::abs(result - expected) < 1e-6;
+  std::cout << (same ? "results match" : "results differ") << std::endl;
+  return same ? 0 : 1;
+}
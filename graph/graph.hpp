@@ -0,0 +1,471 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "../others/flat_hash_map.hpp"
+#include "../others/optional.hpp"
+#include "arena.hpp"
+#include "cache_codec.hpp"
+#include "trace.hpp"
+
+// the persistent pass cache needs POSIX (mmap, flock); elsewhere PassCache
+// stays incomplete and runPass() always runs the pass
+#if defined(__unix__) || defined(__APPLE__)
+#define GRAPH_PASS_CACHE 1
+#include "pass_cache.hpp"
+#else
+class PassCache;
+#endif
+
+struct ImageData {
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t format;
+  uint32_t usage;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const ImageData &data) {
+  os << "width: " << data.width << ", height: " << data.height
+     << ", depth: " << data.depth << ", format: " << data.format
+     << ", usage: " << data.usage;
+  return os;
+}
+inline std::istream &operator>>(std::istream &is, ImageData &data) {
+  std::string token;
+  is >> token >> data.width >> token >> data.height >> token >> data.depth >>
+      token >> data.format >> token >> data.usage;
+  return is;
+}
+// structural hash of the descriptor, see others/hash.hpp
+inline auto hashFields(const ImageData &data) {
+  return std::tie(data.width, data.height, data.depth, data.format,
+                  data.usage);
+}
+
+struct BufferData {
+  uint32_t size;
+  uint32_t usage;
+};
+inline std::ostream &operator<<(std::ostream &os, const BufferData &data) {
+  os << "size: " << data.size << ", usage: " << data.usage;
+  return os;
+}
+inline std::istream &operator>>(std::istream &is, BufferData &data) {
+  std::string token;
+  is >> token >> data.size >> token >> data.usage;
+  return is;
+}
+inline auto hashFields(const BufferData &data) {
+  return std::tie(data.size, data.usage);
+}
+
+struct GPUResource {
+  uint32_t handle;
+};
+
+// ~0u is never handed out as a handle, Optional<GPUResource> keeps its empty
+// state there and stays the size of the handle
+template <> struct NicheTraits<GPUResource> {
+  static constexpr bool available = true;
+  static constexpr GPUResource empty() { return {~0u}; }
+  static constexpr bool isEmpty(const GPUResource &resource) {
+    return resource.handle == ~0u;
+  }
+};
+static_assert(sizeof(Optional<GPUResource>) == sizeof(GPUResource));
+static_assert(FastHashable<ImageData> && FastHashable<BufferData>);
+
+// payload size of a resource; format is opaque, texels are taken as 32 bit
+inline uint64_t byteSize(const ImageData &data) {
+  return uint64_t(data.width) * data.height * std::max(data.depth, 1u) * 4;
+}
+inline uint64_t byteSize(const BufferData &data) { return data.size; }
+
+// node and resource names live in the frame arena, see arena.hpp
+using Name = std::pmr::string;
+
+template <typename K, typename V>
+using FrameHashMap =
+    FlatHashMap<K, V, Hash, std::equal_to<>,
+                std::pmr::polymorphic_allocator<std::pair<const K, V>>>;
+
+struct Edge {
+  Name src;
+  Name dst;
+};
+
+struct EdgeRecorder {
+  FrameHashMap<Name, std::pmr::vector<Edge>> edges;
+
+  explicit EdgeRecorder(std::pmr::memory_resource *resource = frameResource())
+      : edges(resource) {}
+
+  void record(std::string_view src, std::string_view dst) {
+    auto *resource = edges.get_allocator().resource();
+    edges[src].emplace_back(Name(src, resource), Name(dst, resource));
+  }
+
+  // forgets all edges, new ones go to resource; the allocator of a pmr
+  // container does not change on assignment, so the map is rebuilt
+  void reset(std::pmr::memory_resource *resource = frameResource()) {
+    std::destroy_at(&edges);
+    std::construct_at(&edges, resource);
+  }
+};
+
+// reset() it at the start of every frame like NamingPool, and onto the
+// default resource before the arena of the last frame goes away
+inline EdgeRecorder edge_recorder(std::pmr::get_default_resource());
+
+// names are unique within a frame, reset() at the start of every frame and
+// always before the arena the previous names came from is reset
+struct NamingPool {
+  static Name getName(std::string_view name) {
+    auto &mapping = pool();
+    uint32_t index = 0;
+    auto it = mapping.find(name);
+    if (it == mapping.end()) {
+      mapping.try_emplace(name, index);
+    } else {
+      index = it->second++;
+    }
+    Name result(name, frameResource());
+    result += std::to_string(index);
+    return result;
+  }
+
+  // forgets all names, new entries go to the current frameResource()
+  static void reset() { mapping.emplace(frameResource()); }
+
+  // drops the entries, call it before the arena they live in is destroyed
+  static void release() { mapping.reset(); }
+
+private:
+  using Mapping = FrameHashMap<Name, uint32_t>;
+  static inline Optional<Mapping> mapping;
+
+  static Mapping &pool() {
+    if (!mapping)
+      reset();
+    return *mapping;
+  }
+};
+
+template <typename T>
+concept ResourceData =
+    std::is_same_v<T, ImageData> || std::is_same_v<T, BufferData>;
+
+template <ResourceData T> struct ResourceNode {
+  const T data;
+  const Name name;
+  ResourceNode(const T &data, std::string_view name)
+      : data(data), name(name, frameResource()) {}
+  ResourceNode(const T &data, Name &&name)
+      : data(data), name(std::move(name)) {}
+
+  // copies stay in the arena of the original
+  ResourceNode(const ResourceNode &other)
+      : data(other.data), name(other.name, other.name.get_allocator()) {}
+
+  ResourceNode &operator=(const ResourceNode &other) {
+    if (this != &other) {
+      new (this) ResourceNode(other); // placement new
+    }
+    return *this;
+  }
+};
+
+template <ResourceData T> struct IResourceNode : public ResourceNode<T> {
+  using ResourceNode<T>::ResourceNode;
+  const GPUResource resource;
+
+  IResourceNode(const T &data, std::string_view name,
+                const GPUResource &resource)
+      : ResourceNode<T>(data, name), resource(resource) {}
+  IResourceNode(const T &data, Name &&name, const GPUResource &resource)
+      : ResourceNode<T>(data, std::move(name)), resource(resource) {}
+};
+
+// functor that can be used to construct relationships between nodes; a
+// functor redeclares cacheVersion with a higher value when its output for the
+// same input changes, see passCacheKey()
+template <typename T, typename U> struct Functor {
+  using input_type = T;
+  using output_type = U;
+  static constexpr uint32_t cacheVersion = 0;
+  virtual U operator()(const T &input) = 0;
+};
+
+// content of a resource for pass cache keys; nodes carry no payload yet, so
+// the descriptor stands for the content
+template <ResourceData T>
+uint64_t contentHash(const T &data, uint64_t seed = 0) {
+  return hashValue(data, seed);
+}
+template <ResourceData T>
+uint64_t contentHash(const ResourceNode<T> &node, uint64_t seed = 0) {
+  return hashValue(node.data, seed);
+}
+template <typename... Ts>
+uint64_t contentHash(const std::tuple<Ts...> &input, uint64_t seed = 0) {
+  return std::apply(
+      [seed](const auto &...node) {
+        uint64_t h = seed;
+        ((h = hashCombine(h, contentHash(node, h))), ...);
+        return h;
+      },
+      input);
+}
+
+template <> struct CacheCodec<Name> {
+  static void write(std::vector<std::byte> &out, const Name &name) {
+    CacheCodec<uint32_t>::write(out, static_cast<uint32_t>(name.size()));
+    auto p = reinterpret_cast<const std::byte *>(name.data());
+    out.insert(out.end(), p, p + name.size());
+  }
+  static Name read(std::span<const std::byte> &in) {
+    uint32_t size = CacheCodec<uint32_t>::read(in);
+    auto bytes = cacheTake(in, size);
+    return Name(reinterpret_cast<const char *>(bytes.data()), size,
+                frameResource());
+  }
+};
+
+template <ResourceData T> struct CacheCodec<IResourceNode<T>> {
+  static void write(std::vector<std::byte> &out, const IResourceNode<T> &node) {
+    CacheCodec<T>::write(out, node.data);
+    CacheCodec<Name>::write(out, node.name);
+    CacheCodec<GPUResource>::write(out, node.resource);
+  }
+  static IResourceNode<T> read(std::span<const std::byte> &in) {
+    T data = CacheCodec<T>::read(in);
+    Name name = CacheCodec<Name>::read(in);
+    GPUResource resource = CacheCodec<GPUResource>::read(in);
+    return IResourceNode<T>(data, std::move(name), resource);
+  }
+};
+
+// runs a pass, or decodes its outputs from the cache when the same pass ran
+// on the same input content before; passes without outputs always run, an
+// entry that does not decode counts as a miss and a failed store only shows
+// in the cache stats
+template <typename F>
+auto runPass(PassCache *cache, F &&pass,
+             const typename std::remove_cvref_t<F>::input_type &input) ->
+    typename std::remove_cvref_t<F>::output_type {
+  using Pass = std::remove_cvref_t<F>;
+  using Output = typename Pass::output_type;
+  if constexpr (std::is_void_v<Output>) {
+    pass(input);
+  } else {
+#if defined(GRAPH_PASS_CACHE)
+    if (!cache)
+      return pass(input);
+    CacheKey key = passCacheKey<Pass>(input);
+    if (auto blob = cache->lookup(key)) {
+      TRACE_ZONE("PassCache::hit", typeid(Pass).name());
+      try {
+        return decodeCacheEntry<Output>(blob->bytes());
+      } catch (const std::runtime_error &) {
+        cache->discard(key);
+      }
+    }
+    Output output = pass(input);
+    cache->store(key, encodeCacheEntry(output));
+    return output;
+#else
+    (void)cache;
+    return pass(input);
+#endif
+  }
+}
+
+// load functor
+template <ResourceData T>
+struct LoadFunctor : public Functor<T, IResourceNode<T>> {
+  using Functor<T, IResourceNode<T>>::Functor;
+  IResourceNode<T> operator()(const T &input) override {
+    auto name = NamingPool::getName("load");
+    TRACE_ZONE("LoadFunctor", name);
+    std::cout << "Loading resource " << input << std::endl;
+    // TODO (yiwenxue): implement loading
+    return IResourceNode<T>(input, std::move(name), {0});
+  }
+};
+
+// store functor
+template <ResourceData T>
+struct StoreFunctor : public Functor<IResourceNode<T>, void> {
+  using Functor<IResourceNode<T>, void>::Functor;
+  void operator()(const IResourceNode<T> &input) override {
+    TRACE_ZONE("StoreFunctor", input.name);
+    std::cout << "Storing resource " << input.data << std::endl;
+    // TODO (yiwenxue): implement store
+  }
+};
+
+/**
+    // deferred rendering
+    const auto colorMap = loadTexture();
+    const auto normalMap = loadTexture();
+    const auto depthMap = loadTexture();
+
+    // deferred shading, G-buffer pass
+    const auto {position, normal, albedo, specular} = deferredShading(
+        colorMap, normalMap, depthMap);
+
+    // lighting pass
+    const auto lightMap = lightingPass(position, normal, albedo, specular);
+
+    // post processing
+    const auto finalImage = postProcessing(lightMap);
+
+    // render to screen
+    renderToScreen(finalImage);
+ */
+using deferredShadingInputs =
+    std::tuple<ResourceNode<ImageData>, ResourceNode<ImageData>,
+               ResourceNode<ImageData>>;
+using deferredShadingOutputs =
+    std::tuple<IResourceNode<ImageData>, IResourceNode<ImageData>,
+               IResourceNode<ImageData>, IResourceNode<ImageData>>;
+struct DeferredShadingFunctor
+    : public Functor<deferredShadingInputs, deferredShadingOutputs> {
+  deferredShadingOutputs
+  operator()(const deferredShadingInputs &input) override {
+    TRACE_ZONE("DeferredShadingFunctor", std::get<0>(input).name);
+    std::cout << "deferred shading" << std::endl;
+    // TODO (yiwenxue): implement deferred shading
+    return std::make_tuple(
+        IResourceNode<ImageData>(std::get<0>(input).data,
+                                 NamingPool::getName("position"), {0}),
+        IResourceNode<ImageData>(std::get<0>(input).data,
+                                 NamingPool::getName("normal"), {0}),
+        IResourceNode<ImageData>(std::get<0>(input).data,
+                                 NamingPool::getName("albedo"), {0}),
+        IResourceNode<ImageData>(std::get<0>(input).data,
+                                 NamingPool::getName("specular"), {0}));
+  }
+};
+
+using lightingPassInputs =
+    std::tuple<IResourceNode<ImageData>, IResourceNode<ImageData>,
+               IResourceNode<ImageData>, IResourceNode<ImageData>>;
+using lightingPassOutputs = std::tuple<IResourceNode<ImageData>>;
+struct LightingPassFunctor
+    : public Functor<lightingPassInputs, lightingPassOutputs> {
+  lightingPassOutputs operator()(const lightingPassInputs &input) override {
+    TRACE_ZONE("LightingPassFunctor", std::get<0>(input).name);
+    std::cout << "lighting pass" << std::endl;
+    // TODO (yiwenxue): implement lighting pass
+    return std::make_tuple(IResourceNode<ImageData>(
+        std::get<0>(input).data, NamingPool::getName("lightMap"), {0}));
+  }
+};
+
+using postProcessingInputs = std::tuple<IResourceNode<ImageData>>;
+using postProcessingOutputs = std::tuple<IResourceNode<ImageData>>;
+struct PostProcessingFunctor
+    : public Functor<postProcessingInputs, postProcessingOutputs> {
+  postProcessingOutputs operator()(const postProcessingInputs &input) override {
+    TRACE_ZONE("PostProcessingFunctor", std::get<0>(input).name);
+    std::cout << "post processing" << std::endl;
+    // TODO (yiwenxue): implement post processing
+    return std::make_tuple(IResourceNode<ImageData>(
+        std::get<0>(input).data, NamingPool::getName("post"), {0}));
+  }
+};
+
+using presentInput = std::tuple<IResourceNode<ImageData>>;
+using presentOutput = void;
+struct PresentFunctor : public Functor<presentInput, void> {
+  void operator()(const presentInput &input) override {
+    TRACE_ZONE("PresentFunctor", std::get<0>(input).name);
+    std::cout << "present" << std::endl;
+    // TODO (yiwenxue): implement present
+  }
+};
+
+/**
+    // hair dynamics simulation
+    const auto hairInitPos = loadBuffer();
+    const auto hairInitVel = loadBuffer();
+    const auto hairDensity = loadBuffer();
+    const auto hairMass = loadBuffer();
+
+    // first step: advection
+    const auto { hairPos1 } = advection(hairInitPos, hairInitVel, hairMass);
+
+    // second step: constraints and collision
+    const auto { hairPos2, hairVel1 } = constraintsAndCollision(
+        hairPos1, hairDensity, hairMass);
+
+    // third step: solve internal forces
+    const auto { hairPos3, hairVel2, hairDensity1 } = solveInternalForces(
+        hairPos2, hairVel1, hairDensity, hairMass);
+
+    // save results
+    saveBuffer(hairPos3);
+    saveBuffer(hairVel2);
+    saveBuffer(hairDensity1);
+ */
+
+// surrogate resource data generator, fill data with random values; sizes
+// stay within what an in-memory pass can hold (at most 4096 x 4096 x 1 and
+// 64 MiB), resources larger than RAM go through TiledGraph, see tiled.hpp
+template <ResourceData T> T surrogateResourceData(const std::string &name) {
+#define random32 static_cast<uint32_t>(rand())
+  if constexpr (std::is_same_v<T, ImageData>) {
+    return ImageData{1 + random32 % 4096, 1 + random32 % 4096, 1, random32,
+                     random32};
+  } else if constexpr (std::is_same_v<T, BufferData>) {
+    return BufferData{1 + random32 % (64u << 20), random32};
+  }
+}
+
+// with a cache, passes whose inputs did not change since an earlier run
+// (of any process sharing the cache directory) are skipped
+inline auto deferredShading(PassCache *cache = nullptr) -> void {
+  // deferred rendering
+  const auto colorMap = runPass(cache, LoadFunctor<ImageData>(),
+                                surrogateResourceData<ImageData>("colorMap"));
+  const auto normalMap = runPass(cache, LoadFunctor<ImageData>(),
+                                 surrogateResourceData<ImageData>("normalMap"));
+  const auto depthMap = runPass(cache, LoadFunctor<ImageData>(),
+                                surrogateResourceData<ImageData>("depthMap"));
+
+  // deferred shading, G-buffer pass
+  const auto [position, normal, albedo, specular] =
+      runPass(cache, DeferredShadingFunctor(),
+              std::make_tuple(colorMap, normalMap, depthMap));
+
+  // lighting pass
+  const auto [lightMap] =
+      runPass(cache, LightingPassFunctor(),
+              std::make_tuple(position, normal, albedo, specular));
+
+  // post processing
+  const auto [finalImage] =
+      runPass(cache, PostProcessingFunctor(), std::make_tuple(lightMap));
+
+  // render to screen
+  runPass(cache, PresentFunctor(), std::make_tuple(finalImage));
+}
+
+inline auto hairSimulation() -> void {
+  const auto hairInitPos = LoadFunctor<BufferData>()(
+      surrogateResourceData<BufferData>("hairInitPos"));
+}
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../others/optional.hpp"
+#include "cache_codec.hpp"
+
+/**
+ persistent, content addressed cache of pass outputs (POSIX)
+
+ 1. the key of a pass run is a 128 bit hash of the pass type and its
+    cacheVersion, of the content of its inputs, see contentHash(), and of
+    the encoding version cacheFormat, see cache_codec.hpp;
+ 2. every entry is one file <dir>/<key>.bin, written to a temporary file and
+    renamed into place, so readers never see a partial entry;
+ 3. hits are mapped read-only with mmap and decoded from the mapping, a hit
+    also bumps the file mtime which is the LRU clock; decoding checks every
+    read against the entry size and a failed decode is a miss;
+ 4. when the directory grows beyond its budget the oldest entries are
+    unlinked under an exclusive flock on <dir>/.lock; a process that still
+    has an evicted entry mapped keeps reading it safely.
+
+ several processes can share one directory.
+*/
+
+
+// read-only mapping of one cache entry, bytes() skips the file header
+class MappedBlob {
+  void *address_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t offset_ = 0;
+
+public:
+  MappedBlob() = default;
+  MappedBlob(void *address, std::size_t size, std::size_t offset)
+      : address_(address), size_(size), offset_(offset) {}
+  MappedBlob(MappedBlob &&other) noexcept
+      : address_(std::exchange(other.address_, nullptr)),
+        size_(std::exchange(other.size_, 0)), offset_(other.offset_) {}
+  MappedBlob &operator=(MappedBlob &&other) noexcept {
+    std::swap(address_, other.address_);
+    std::swap(size_, other.size_);
+    std::swap(offset_, other.offset_);
+    return *this;
+  }
+  ~MappedBlob() {
+    if (address_)
+      munmap(address_, size_);
+  }
+
+  std::span<const std::byte> bytes() const {
+    return std::span(static_cast<const std::byte *>(address_), size_)
+        .subspan(offset_);
+  }
+};
+
+class PassCache {
+public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t stores = 0;
+    uint64_t failedStores = 0;
+    uint64_t evictions = 0;
+  };
+
+  PassCache(std::filesystem::path directory, uint64_t maxBytes)
+      : directory_(std::move(directory)), maxBytes_(maxBytes) {
+    std::filesystem::create_directories(directory_);
+  }
+
+  // the payload of key without the header, or nothing on a miss
+  Optional<MappedBlob> lookup(const CacheKey &key) {
+    auto path = entryPath(key);
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      ++stats_.misses;
+      return {};
+    }
+    struct stat info;
+    void *address = MAP_FAILED;
+    if (fstat(fd, &info) == 0 &&
+        static_cast<std::size_t>(info.st_size) >= sizeof(Header))
+      address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED)
+      futimens(fd, nullptr); // LRU: the entry was just used
+    ::close(fd);
+    if (address == MAP_FAILED) {
+      ++stats_.misses;
+      return {};
+    }
+
+    MappedBlob blob(address, info.st_size, sizeof(Header));
+    Header header;
+    std::memcpy(&header, address, sizeof(header));
+    uint64_t payload = static_cast<uint64_t>(info.st_size) - sizeof(Header);
+    if (header.magic != Header::expected || header.size != payload) {
+      ++stats_.misses; // foreign or truncated file, treat it as absent
+      return {};
+    }
+    ++stats_.hits;
+    return blob;
+  }
+
+  // false when the entry could not be written (full disk, read-only
+  // directory); that is counted in stats().failedStores, a cache must not
+  // fail the frame that produced the payload
+  bool store(const CacheKey &key, std::span<const std::byte> payload) {
+    static std::atomic<uint64_t> counter{0};
+    auto temporary =
+        directory_ /
+        (".tmp." + std::to_string(getpid()) + "." +
+         std::to_string(std::hash<std::thread::id>{}(
+             std::this_thread::get_id())) +
+         "." + std::to_string(counter.fetch_add(1)));
+    int fd = ::open(temporary.c_str(),
+                    O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      ++stats_.failedStores;
+      return false;
+    }
+    Header header{Header::expected, payload.size()};
+    bool ok = writeAll(fd, &header, sizeof(header)) &&
+              writeAll(fd, payload.data(), payload.size());
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), entryPath(key).c_str()) != 0) {
+      ::unlink(temporary.c_str());
+      ++stats_.failedStores;
+      return false;
+    }
+    ++stats_.stores;
+    written_ += sizeof(header) + payload.size();
+    if (written_ >= maxBytes_ / 8) { // amortize the directory scan
+      written_ = 0;
+      evict();
+    }
+    return true;
+  }
+
+  // removes least recently used entries until the budget is met
+  void evict() {
+    int lock = ::open((directory_ / ".lock").c_str(),
+                      O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock < 0)
+      return;
+    flock(lock, LOCK_EX);
+
+    struct Entry {
+      std::filesystem::path path;
+      uint64_t size;
+      std::filesystem::file_time_type used;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    for (const auto &file :
+         std::filesystem::directory_iterator(directory_, error)) {
+      if (file.path().extension() != ".bin")
+        continue;
+      // removed by another process meanwhile: each call reports it, one
+      // shared error_code would let the second call hide the first
+      std::error_code sizeError, timeError;
+      uint64_t size = file.file_size(sizeError);
+      auto used = file.last_write_time(timeError);
+      if (sizeError || timeError)
+        continue;
+      entries.push_back({file.path(), size, used});
+      total += size;
+    }
+    if (total > maxBytes_) {
+      std::sort(entries.begin(), entries.end(),
+                [](const Entry &a, const Entry &b) { return a.used < b.used; });
+      for (const auto &entry : entries) {
+        if (total <= maxBytes_)
+          break;
+        if (std::filesystem::remove(entry.path, error))
+          ++stats_.evictions;
+        total -= entry.size;
+      }
+    }
+
+    flock(lock, LOCK_UN);
+    ::close(lock);
+  }
+
+  // a looked up entry that failed to decode: counted as a miss instead of a
+  // hit and removed, the next store replaces it
+  void discard(const CacheKey &key) {
+    --stats_.hits;
+    ++stats_.misses;
+    std::error_code error;
+    std::filesystem::remove(entryPath(key), error);
+  }
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  struct Header {
+    static constexpr uint64_t expected = 0x3176656863616370ull; // "pcachev1"
+    uint64_t magic;
+    uint64_t size;
+  };
+
+  std::filesystem::path directory_;
+  uint64_t maxBytes_;
+  uint64_t written_ = 0;
+  Stats stats_;
+
+  std::filesystem::path entryPath(const CacheKey &key) const {
+    return directory_ / (key.hex() + ".bin");
+  }
+
+  static bool writeAll(int fd, const void *data, std::size_t size) {
+    auto p = static_cast<const char *>(data);
+    while (size > 0) {
+      ssize_t n = ::write(fd, p, size);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= n;
+    }
+    return true;
+  }
+};
@@ -0,0 +1,388 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ declarative pass graph with fusion of per element passes
+
+ 1. resources are float arrays of a known element count, passes declare what
+    they read and write and run a kernel over a range of elements;
+ 2. a PerElement pass computes element i of its outputs from element i of
+    its inputs only, so it can run tile by tile; a Global pass (blur,
+    reduction, ...) always sees whole resources;
+ 3. compile() orders the passes and, unless disabled, fuses a PerElement
+    producer into its PerElement consumer when the resource between them has
+    exactly that one reader and is not a graph output; the merge must not
+    create a cycle, i.e. no other path may lead from producer to consumer;
+ 4. a fused group runs tile by tile, the intermediates of the group live in
+    a tile sized scratch buffer that stays in cache and are never allocated
+    at full size; FusionReport lists what was fused and the bytes saved.
+*/
+
+using ResourceId = uint32_t;
+using PassId = uint32_t;
+
+enum class PassKind { PerElement, Global };
+
+struct FusionReport {
+  struct Fusion {
+    std::string producer;
+    std::string consumer;
+    std::string intermediate;
+    uint64_t bytes;
+  };
+  std::vector<Fusion> fusions;
+  std::vector<std::vector<std::string>> groups; // execution order
+  uint64_t bytesAllocated = 0;
+  uint64_t bytesEliminated = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const FusionReport &report) {
+  for (const auto &fusion : report.fusions)
+    os << "fused " << fusion.producer << " -> " << fusion.consumer << ", "
+       << fusion.intermediate << " eliminated (" << fusion.bytes
+       << " bytes)\n";
+  for (const auto &group : report.groups) {
+    os << "step:";
+    for (const auto &pass : group)
+      os << " " << pass;
+    os << "\n";
+  }
+  os << report.bytesAllocated << " bytes allocated, "
+     << report.bytesEliminated << " bytes eliminated";
+  return os;
+}
+
+class CompiledGraph;
+
+class PassGraph {
+public:
+  // in[i] / out[i] point at the first element of the range, count elements
+  using Kernel = std::function<void(std::span<const float *const> in,
+                                    std::span<float *const> out,
+                                    std::size_t count)>;
+
+  struct Resource {
+    std::string name;
+    std::size_t elements;
+    PassId writer = ~0u;
+    std::vector<PassId> readers;
+    bool output = false;
+  };
+
+  struct Pass {
+    std::string name;
+    PassKind kind;
+    std::vector<ResourceId> reads;
+    std::vector<ResourceId> writes;
+    Kernel kernel;
+  };
+
+  ResourceId addResource(std::string name, std::size_t elements) {
+    resources_.push_back({std::move(name), elements, ~0u, {}, false});
+    return static_cast<ResourceId>(resources_.size() - 1);
+  }
+
+  PassId addPass(std::string name, PassKind kind, std::vector<ResourceId> reads,
+                 std::vector<ResourceId> writes, Kernel kernel) {
+    PassId id = static_cast<PassId>(passes_.size());
+    if (kind == PassKind::PerElement) {
+      std::size_t elements = ~std::size_t(0);
+      for (auto list : {&reads, &writes})
+        for (ResourceId r : *list) {
+          if (elements == ~std::size_t(0))
+            elements = resources_.at(r).elements;
+          if (resources_.at(r).elements != elements)
+            throw std::logic_error("per element pass " + name +
+                                   " mixes resource sizes");
+        }
+    }
+    for (ResourceId r : writes) {
+      if (resources_.at(r).writer != ~0u)
+        throw std::logic_error("resource " + resources_[r].name +
+                               " has two writers");
+      resources_[r].writer = id;
+    }
+    for (ResourceId r : reads)
+      resources_.at(r).readers.push_back(id);
+    passes_.push_back({std::move(name), kind, std::move(reads),
+                       std::move(writes), std::move(kernel)});
+    return id;
+  }
+
+  // outputs are always materialized, never fused away
+  void markOutput(ResourceId id) { resources_.at(id).output = true; }
+
+  const std::vector<Resource> &resources() const { return resources_; }
+  const std::vector<Pass> &passes() const { return passes_; }
+
+  CompiledGraph compile(bool fuse = true, std::size_t tile = 1024) const;
+
+private:
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+};
+
+// owns the materialized resources, operands point into them: move only
+class CompiledGraph {
+public:
+  CompiledGraph(CompiledGraph &&) = default;
+  CompiledGraph &operator=(CompiledGraph &&) = default;
+  CompiledGraph(const CompiledGraph &) = delete;
+  CompiledGraph &operator=(const CompiledGraph &) = delete;
+
+  // Global passes get the element count of their largest resource
+  void execute() {
+    for (auto &step : steps_) {
+      if (!step.tiled) {
+        auto &bound = step.passes.front();
+        bind(bound, 0);
+        passes_[bound.pass].kernel(bound.in, bound.out, step.elements);
+        continue;
+      }
+      for (std::size_t start = 0; start < step.elements; start += tile_) {
+        std::size_t count = std::min(tile_, step.elements - start);
+        for (auto &bound : step.passes) {
+          bind(bound, start);
+          passes_[bound.pass].kernel(bound.in, bound.out, count);
+        }
+      }
+    }
+  }
+
+  // storage of a materialized resource, inputs are filled through it
+  std::span<float> buffer(ResourceId id) {
+    if (storage_.at(id).empty() && elements_[id] != 0)
+      throw std::out_of_range("resource " + std::to_string(id) +
+                              " was eliminated by fusion");
+    return storage_[id];
+  }
+
+  const FusionReport &report() const { return report_; }
+
+private:
+  friend class PassGraph;
+
+  CompiledGraph() = default;
+
+  struct Operand {
+    float *base;
+    bool scratch; // tile local, does not advance with the tile
+  };
+
+  struct BoundPass {
+    PassId pass;
+    std::vector<Operand> reads;
+    std::vector<Operand> writes;
+    std::vector<const float *> in;
+    std::vector<float *> out;
+  };
+
+  struct Step {
+    std::vector<BoundPass> passes;
+    std::size_t elements = 0;
+    bool tiled = false;
+  };
+
+  std::vector<PassGraph::Pass> passes_;
+  std::vector<std::size_t> elements_;
+  std::vector<std::vector<float>> storage_;
+  std::vector<std::vector<float>> scratch_;
+  std::vector<Step> steps_;
+  std::size_t tile_ = 0;
+  FusionReport report_;
+
+  static void bind(BoundPass &bound, std::size_t start) {
+    for (std::size_t i = 0; i < bound.reads.size(); ++i)
+      bound.in[i] = bound.reads[i].base + (bound.reads[i].scratch ? 0 : start);
+    for (std::size_t i = 0; i < bound.writes.size(); ++i)
+      bound.out[i] =
+          bound.writes[i].base + (bound.writes[i].scratch ? 0 : start);
+  }
+};
+
+inline CompiledGraph PassGraph::compile(bool fuse, std::size_t tile) const {
+  const std::size_t n = passes_.size();
+  auto producer = [this](ResourceId r) { return resources_[r].writer; };
+
+  // pass order (Kahn, ties broken by declaration order)
+  std::vector<uint32_t> waiting(n);
+  for (PassId p = 0; p < n; ++p)
+    for (ResourceId r : passes_[p].reads)
+      waiting[p] += producer(r) != ~0u;
+  std::vector<PassId> order;
+  std::deque<PassId> ready;
+  for (PassId p = 0; p < n; ++p)
+    if (waiting[p] == 0)
+      ready.push_back(p);
+  while (!ready.empty()) {
+    PassId p = ready.front();
+    ready.pop_front();
+    order.push_back(p);
+    for (ResourceId r : passes_[p].writes)
+      for (PassId reader : resources_[r].readers)
+        if (--waiting[reader] == 0)
+          ready.push_back(reader);
+  }
+  if (order.size() != n)
+    throw std::logic_error("PassGraph has a dependency cycle");
+  std::vector<std::size_t> rank(n);
+  for (std::size_t i = 0; i < n; ++i)
+    rank[order[i]] = i;
+
+  // every pass starts in a group of its own
+  std::vector<std::vector<PassId>> groups(n);
+  std::vector<uint32_t> groupOf(n);
+  for (PassId p = 0; p < n; ++p) {
+    groups[p] = {p};
+    groupOf[p] = p;
+  }
+  std::vector<bool> fused(resources_.size());
+
+  CompiledGraph compiled;
+  auto successors = [&](uint32_t group) {
+    std::vector<uint32_t> next;
+    for (PassId p : groups[group])
+      for (ResourceId r : passes_[p].writes)
+        for (PassId reader : resources_[r].readers)
+          if (groupOf[reader] != group)
+            next.push_back(groupOf[reader]);
+    return next;
+  };
+  // true when to is reachable from "from" without the direct edge
+  auto indirect = [&](uint32_t from, uint32_t to) {
+    std::vector<bool> seen(n);
+    std::vector<uint32_t> stack;
+    for (uint32_t g : successors(from))
+      if (g != to && !seen[g]) {
+        seen[g] = true;
+        stack.push_back(g);
+      }
+    while (!stack.empty()) {
+      uint32_t g = stack.back();
+      stack.pop_back();
+      if (g == to)
+        return true;
+      for (uint32_t next : successors(g))
+        if (!seen[next]) {
+          seen[next] = true;
+          stack.push_back(next);
+        }
+    }
+    return false;
+  };
+
+  for (bool changed = fuse; changed;) {
+    changed = false;
+    for (ResourceId r = 0; r < resources_.size() && !changed; ++r) {
+      const auto &resource = resources_[r];
+      if (fused[r] || resource.output || resource.writer == ~0u ||
+          resource.readers.size() != 1)
+        continue;
+      PassId from = resource.writer, to = resource.readers.front();
+      if (passes_[from].kind != PassKind::PerElement ||
+          passes_[to].kind != PassKind::PerElement)
+        continue;
+      uint32_t a = groupOf[from], b = groupOf[to];
+      if (a != b && indirect(a, b))
+        continue;
+      if (a != b) {
+        for (PassId p : groups[b])
+          groupOf[p] = a;
+        groups[a].insert(groups[a].end(), groups[b].begin(), groups[b].end());
+        groups[b].clear();
+      }
+      fused[r] = true;
+      uint64_t bytes = resource.elements * sizeof(float);
+      compiled.report_.fusions.push_back(
+          {passes_[from].name, passes_[to].name, resource.name, bytes});
+      compiled.report_.bytesEliminated += bytes;
+      changed = true;
+    }
+  }
+
+  // groups run in the order of their first pass, members in pass order
+  std::vector<uint32_t> live;
+  for (uint32_t g = 0; g < n; ++g)
+    if (!groups[g].empty()) {
+      std::sort(groups[g].begin(), groups[g].end(),
+                [&](PassId x, PassId y) { return rank[x] < rank[y]; });
+      live.push_back(g);
+    }
+  // a merged group may have to wait for a pass ranked between its members
+  std::vector<uint32_t> pending(n);
+  for (uint32_t g : live)
+    for (uint32_t next : successors(g))
+      ++pending[next];
+  std::vector<uint32_t> groupOrder;
+  std::vector<uint32_t> candidates;
+  for (uint32_t g : live)
+    if (pending[g] == 0)
+      candidates.push_back(g);
+  while (!candidates.empty()) {
+    auto it = std::min_element(
+        candidates.begin(), candidates.end(), [&](uint32_t x, uint32_t y) {
+          return rank[groups[x].front()] < rank[groups[y].front()];
+        });
+    uint32_t g = *it;
+    candidates.erase(it);
+    groupOrder.push_back(g);
+    for (uint32_t next : successors(g))
+      if (--pending[next] == 0)
+        candidates.push_back(next);
+  }
+
+  compiled.passes_ = passes_;
+  compiled.tile_ = tile;
+  compiled.elements_.resize(resources_.size());
+  compiled.storage_.resize(resources_.size());
+  compiled.scratch_.resize(resources_.size());
+  for (ResourceId r = 0; r < resources_.size(); ++r) {
+    compiled.elements_[r] = resources_[r].elements;
+    if (fused[r]) {
+      compiled.scratch_[r].resize(std::min(tile, resources_[r].elements));
+    } else {
+      compiled.storage_[r].resize(resources_[r].elements);
+      compiled.report_.bytesAllocated += resources_[r].elements * sizeof(float);
+    }
+  }
+  auto operand = [&](ResourceId r) -> CompiledGraph::Operand {
+    if (fused[r])
+      return {compiled.scratch_[r].data(), true};
+    return {compiled.storage_[r].data(), false};
+  };
+
+  for (uint32_t g : groupOrder) {
+    CompiledGraph::Step step;
+    std::vector<std::string> names;
+    for (PassId p : groups[g]) {
+      const auto &pass = passes_[p];
+      CompiledGraph::BoundPass bound{p, {}, {}, {}, {}};
+      for (ResourceId r : pass.reads)
+        bound.reads.push_back(operand(r));
+      for (ResourceId r : pass.writes)
+        bound.writes.push_back(operand(r));
+      bound.in.resize(pass.reads.size());
+      bound.out.resize(pass.writes.size());
+      step.passes.push_back(std::move(bound));
+      names.push_back(pass.name);
+      for (auto list : {&pass.reads, &pass.writes})
+        for (ResourceId r : *list)
+          step.elements = std::max(step.elements, resources_[r].elements);
+    }
+    step.tiled = step.passes.size() > 1;
+    compiled.steps_.push_back(std::move(step));
+    compiled.report_.groups.push_back(std::move(names));
+  }
+  return compiled;
+}
@@ -0,0 +1,115 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "frame_pipeline.hpp"
+#include "pass_graph.hpp"
+
+// the lighting -> post frame of fusion.cpp in a pipelined frame loop: frame
+// N + 1 is recorded and compiled while frame N executes
+
+constexpr std::size_t pixels = 1024 * 1024;
+
+struct FrameConstants {
+  uint64_t frame = ~uint64_t(0);
+  float light = 0;
+};
+
+struct Recorded {
+  PassGraph graph;
+  ResourceId inputs[2];
+  ResourceId exposure;
+};
+
+struct Compiled {
+  CompiledGraph graph;
+  ResourceId inputs[2];
+  ResourceId exposure;
+};
+
+PipelineStats render(uint32_t framesInFlight, uint64_t frames) {
+  // written by the recorder, read by the executor frames later
+  Versioned<FrameConstants> constants(framesInFlight);
+  uint64_t overwritten = 0;
+  double exposure = 0;
+
+  FramePipeline<Recorded, Compiled> pipeline(
+      framesInFlight,
+      {[&](FrameContext &frame) {
+         constants[frame] = {frame.index, 1.0f + 0.1f * (frame.index % 8)};
+         Recorded recorded;
+         auto &graph = recorded.graph;
+         std::string prefix = "frame" + std::to_string(frame.index) + "/";
+         ResourceId albedo = graph.addResource(prefix + "albedo", pixels);
+         ResourceId normal = graph.addResource(prefix + "normal", pixels);
+         ResourceId lightMap = graph.addResource(prefix + "lightMap", pixels);
+         ResourceId post = graph.addResource(prefix + "post", pixels);
+         ResourceId sum = graph.addResource(prefix + "exposure", 1);
+         float light = constants[frame].light;
+         graph.addPass("lighting", PassKind::PerElement, {albedo, normal},
+                       {lightMap}, [light](auto in, auto out, std::size_t n) {
+                         for (std::size_t i = 0; i < n; ++i)
+                           out[0][i] =
+                               light * in[0][i] * std::max(0.0f, in[1][i]);
+                       });
+         graph.addPass("post", PassKind::PerElement, {lightMap}, {post},
+                       [](auto in, auto out, std::size_t n) {
+                         for (std::size_t i = 0; i < n; ++i)
+                           out[0][i] = in[0][i] / (1.0f + in[0][i]);
+                       });
+         graph.addPass("exposure", PassKind::Global, {post}, {sum},
+                       [](auto in, auto out, std::size_t n) {
+                         double total = 0;
+                         for (std::size_t i = 0; i < n; ++i)
+                           total += in[0][i];
+                         out[0][0] = static_cast<float>(total / n);
+                       });
+         graph.markOutput(sum);
+         recorded.inputs[0] = albedo;
+         recorded.inputs[1] = normal;
+         recorded.exposure = sum;
+         return recorded;
+       },
+       [](FrameContext &, Recorded &&recorded) {
+         Compiled compiled{recorded.graph.compile(),
+                           {recorded.inputs[0], recorded.inputs[1]},
+                           recorded.exposure};
+         for (ResourceId r : compiled.inputs) {
+           auto data = compiled.graph.buffer(r);
+           for (std::size_t i = 0; i < data.size(); ++i)
+             data[i] = 0.5f + 0.5f * std::sin(0.001f * i * (r + 1));
+         }
+         return compiled;
+       },
+       [&](FrameContext &frame, Compiled &&compiled) {
+         if (constants[frame].frame != frame.index)
+           ++overwritten; // cannot happen, the slot is owned until now
+         compiled.graph.execute();
+         exposure += compiled.graph.buffer(compiled.exposure)[0];
+       }});
+
+  auto stats = pipeline.run(frames);
+  std::cout << framesInFlight << " in flight: " << stats.frames << " frames, "
+            << stats.framesPerSecond() << " frames/s, record "
+            << stats.recordMs << " ms, compile " << stats.compileMs
+            << " ms, execute " << stats.executeMs << " ms, stalls "
+            << stats.slotStalls << "/" << stats.compileStalls << "/"
+            << stats.executeStalls << ", mean exposure "
+            << exposure / stats.frames << ", overwritten " << overwritten
+            << std::endl;
+  if (overwritten)
+    std::exit(1);
+  return stats;
+}
+
+// pipeline [frames in flight] [frames]
+int main(int argc, char *argv[]) {
+  uint32_t framesInFlight = argc > 1 ? std::max(1, std::atoi(argv[1])) : 3;
+  uint64_t frames = argc > 2 ? std::max(1, std::atoi(argv[2])) : 24;
+
+  auto serial = render(1, frames);
+  auto pipelined = render(framesInFlight, frames);
+  std::cout << "speedup " << serial.ms / pipelined.ms << "x" << std::endl;
+  return 0;
+}
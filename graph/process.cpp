@@ -0,0 +1,119 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+#include "graph.hpp"
+#include "process_graph.hpp"
+
+// deferred shading with real payloads, every pass runs in a worker process
+// and the images live in shared memory; the GPUResource handle of a node is
+// its resource id in the process graph
+
+constexpr uint32_t side = 512;
+
+template <ResourceData T>
+IResourceNode<T> sharedNode(ProcessGraph &graph, const T &data,
+                            std::string_view name) {
+  Name unique = NamingPool::getName(name);
+  ResourceId id = graph.addResource(std::string(unique), byteSize(data));
+  return IResourceNode<T>(data, std::move(unique), GPUResource{id});
+}
+
+ResourceId id(const IResourceNode<ImageData> &node) {
+  return node.resource.handle;
+}
+
+// fills a texture procedurally, seed tells the maps apart
+ProcessGraph::Kernel load(uint32_t seed) {
+  return [seed](PassContext &context) {
+    auto out = context.output<float>(0);
+    for (uint32_t i = 0; i < out.size(); ++i) {
+      uint32_t x = i % side, y = i / side;
+      out[i] = 0.5f + 0.5f * std::sin(0.01f * (x * seed + y * (seed + 1)));
+    }
+  };
+}
+
+uint64_t shade(ProcessGraph &graph, uint32_t workers, bool crash) {
+  ImageData image{side, side, 1, 0, 0};
+  auto color = sharedNode(graph, image, "colorMap");
+  auto normal = sharedNode(graph, image, "normalMap");
+  auto depth = sharedNode(graph, image, "depthMap");
+  auto albedo = sharedNode(graph, image, "albedo");
+  auto lightMap = sharedNode(graph, image, "lightMap");
+  auto post = sharedNode(graph, image, "post");
+  // survives the crash of a worker, so only the first attempt fails
+  ResourceId crashed = graph.addResource("crashed", sizeof(uint32_t));
+
+  graph.addPass("loadColor", {}, {id(color)}, load(1));
+  graph.addPass("loadNormal", {}, {id(normal)}, load(2));
+  graph.addPass("loadDepth", {}, {id(depth)}, load(3));
+  graph.addPass("gbuffer", {id(color), id(depth)}, {id(albedo)},
+                [](PassContext &context) {
+                  auto c = context.input<float>(0);
+                  auto d = context.input<float>(1);
+                  auto out = context.output<float>(0);
+                  for (std::size_t i = 0; i < out.size(); ++i)
+                    out[i] = c[i] * (1.0f - 0.5f * d[i]);
+                });
+  graph.addPass("lighting", {id(albedo), id(normal)}, {id(lightMap)},
+                [crash, crashed, &graph](PassContext &context) {
+                  auto flag = graph.data<uint32_t>(crashed);
+                  if (crash && flag[0]++ == 0)
+                    std::abort();
+                  auto a = context.input<float>(0);
+                  auto n = context.input<float>(1);
+                  auto out = context.output<float>(0);
+                  for (std::size_t i = 0; i < out.size(); ++i)
+                    out[i] = a[i] * std::max(0.0f, 2.0f * n[i] - 0.5f);
+                });
+  graph.addPass("post", {id(lightMap)}, {id(post)}, [](PassContext &context) {
+    auto in = context.input<float>(0);
+    auto out = context.output<float>(0);
+    for (std::size_t i = 0; i < out.size(); ++i)
+      out[i] = in[i] / (1.0f + in[i]); // reinhard
+  });
+
+  ProcessExecutor executor(graph, workers);
+  auto report = executor.run();
+  for (PassId pass = 0; pass < graph.passes().size(); ++pass)
+    std::cout << "  " << graph.passes()[pass].name << ": worker "
+              << report.passes[pass].worker << ", "
+              << report.passes[pass].attempts << " attempt(s), "
+              << report.passes[pass].ms << " ms" << std::endl;
+  std::cout << "  " << report.ms << " ms, " << report.workerFailures
+            << " worker failure(s)" << std::endl;
+
+  // the coordinator reads the result in place
+  uint64_t checksum = 0;
+  for (float v : graph.data<float>(id(post)))
+    checksum = hashCombine(checksum, static_cast<uint64_t>(v * 65536.0f));
+  return checksum;
+}
+
+// process [workers] [--crash]
+int main(int argc, char *argv[]) {
+  uint32_t workers = 4;
+  bool crash = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::string_view(argv[i]) == "--crash")
+      crash = true;
+    else
+      workers = std::max(1, std::atoi(argv[i]));
+  }
+
+  std::cout << "reference, 1 worker" << std::endl;
+  ProcessGraph reference;
+  uint64_t expected = shade(reference, 1, false);
+
+  std::cout << workers << " workers" << (crash ? ", lighting crashes once" : "")
+            << std::endl;
+  ProcessGraph graph;
+  uint64_t checksum = shade(graph, workers, crash);
+
+  NamingPool::release();
+  std::cout << (checksum == expected ? "results match" : "results differ")
+            << std::endl;
+  return checksum == expected ? 0 : 1;
+}
@@ -0,0 +1,437 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ multi process graph execution (POSIX)
+
+ 1. ProcessGraph declares resources (byte buffers of a known size) and passes
+    reading and writing them; every resource has at most one writer;
+ 2. resources live in POSIX shared memory: shm_open + mmap(MAP_SHARED) in the
+    coordinator, the name is unlinked right away and the forked workers
+    inherit the mapping, so payloads never get copied or serialized and
+    nothing leaks when a process dies;
+ 3. ProcessExecutor forks N workers once and keeps them; run() dispatches
+    ready passes to idle workers over a socketpair per worker, a worker
+    answers with the pass id and a status word;
+ 4. a worker that exits, crashes, exceeds the pass timeout or whose kernel
+    throws is reaped and replaced, the pass is retried up to maxAttempts
+    times before run() gives up.
+
+ fork() copies only the calling thread: create the executor before starting
+ other threads in the coordinator.
+*/
+
+class SharedBuffer {
+  std::byte *data_ = nullptr;
+  std::size_t size_ = 0;
+
+public:
+  SharedBuffer() = default;
+  explicit SharedBuffer(std::size_t size) : size_(size) {
+    static std::atomic<uint32_t> counter{0};
+    std::string name = "/conquer." + std::to_string(getpid()) + "." +
+                       std::to_string(counter.fetch_add(1));
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), "shm_open");
+    shm_unlink(name.c_str()); // the mapping keeps it alive
+    std::size_t mapped = std::max<std::size_t>(size, 1);
+    if (ftruncate(fd, mapped) != 0) {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), "ftruncate");
+    }
+    void *address =
+        mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+      throw std::system_error(errno, std::generic_category(), "mmap");
+    data_ = static_cast<std::byte *>(address);
+  }
+  SharedBuffer(SharedBuffer &&other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+  SharedBuffer &operator=(SharedBuffer &&other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+  ~SharedBuffer() {
+    if (data_)
+      munmap(data_, std::max<std::size_t>(size_, 1));
+  }
+
+  std::span<std::byte> bytes() const { return {data_, size_}; }
+  template <typename T> std::span<T> as() const {
+    return {reinterpret_cast<T *>(data_), size_ / sizeof(T)};
+  }
+};
+
+using ResourceId = uint32_t;
+using PassId = uint32_t;
+
+// what a pass kernel sees, spans point straight into shared memory
+class PassContext {
+  const std::vector<SharedBuffer> *buffers_;
+  const std::vector<ResourceId> *reads_;
+  const std::vector<ResourceId> *writes_;
+
+public:
+  PassContext(const std::vector<SharedBuffer> &buffers,
+              const std::vector<ResourceId> &reads,
+              const std::vector<ResourceId> &writes)
+      : buffers_(&buffers), reads_(&reads), writes_(&writes) {}
+
+  template <typename T = std::byte> std::span<const T> input(std::size_t i) {
+    return (*buffers_)[(*reads_)[i]].as<T>();
+  }
+  template <typename T = std::byte> std::span<T> output(std::size_t i) {
+    return (*buffers_)[(*writes_)[i]].as<T>();
+  }
+};
+
+class ProcessGraph {
+public:
+  using Kernel = std::function<void(PassContext &)>;
+
+  struct Resource {
+    std::string name;
+    PassId writer = ~0u;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<ResourceId> reads;
+    std::vector<ResourceId> writes;
+    Kernel kernel;
+  };
+
+  ResourceId addResource(std::string name, std::size_t bytes) {
+    resources_.push_back({std::move(name)});
+    buffers_.emplace_back(bytes);
+    return static_cast<ResourceId>(resources_.size() - 1);
+  }
+
+  PassId addPass(std::string name, std::vector<ResourceId> reads,
+                 std::vector<ResourceId> writes, Kernel kernel) {
+    PassId id = static_cast<PassId>(passes_.size());
+    for (ResourceId r : writes) {
+      if (resources_.at(r).writer != ~0u)
+        throw std::logic_error("resource " + resources_[r].name +
+                               " has two writers");
+      resources_[r].writer = id;
+    }
+    for (ResourceId r : reads)
+      resources_.at(r); // bounds check
+    passes_.push_back({std::move(name), std::move(reads), std::move(writes),
+                       std::move(kernel)});
+    return id;
+  }
+
+  std::span<std::byte> data(ResourceId id) const {
+    return buffers_.at(id).bytes();
+  }
+  template <typename T> std::span<T> data(ResourceId id) const {
+    return buffers_.at(id).as<T>();
+  }
+
+  const std::vector<Pass> &passes() const { return passes_; }
+  const std::vector<Resource> &resources() const { return resources_; }
+  const std::vector<SharedBuffer> &buffers() const { return buffers_; }
+
+  // passes that must finish before pass id can start
+  std::vector<PassId> dependencies(PassId id) const {
+    std::vector<PassId> deps;
+    for (ResourceId r : passes_[id].reads)
+      if (resources_[r].writer != ~0u)
+        deps.push_back(resources_[r].writer);
+    return deps;
+  }
+
+private:
+  std::vector<Resource> resources_;
+  std::vector<SharedBuffer> buffers_;
+  std::vector<Pass> passes_;
+};
+
+class ProcessExecutor {
+public:
+  struct PassReport {
+    uint32_t worker = 0;
+    uint32_t attempts = 0;
+    double ms = 0;
+  };
+  struct Report {
+    double ms = 0;
+    uint32_t workerFailures = 0;
+    std::vector<PassReport> passes;
+  };
+
+  uint32_t maxAttempts = 3;
+  std::chrono::milliseconds passTimeout{0}; // 0: no timeout
+
+  ProcessExecutor(const ProcessGraph &graph, uint32_t workers)
+      : graph_(graph), workers_(workers) {
+    if (workers == 0)
+      throw std::invalid_argument("ProcessExecutor needs a worker");
+    for (uint32_t i = 0; i < workers; ++i)
+      spawn(i);
+  }
+
+  ProcessExecutor(const ProcessExecutor &) = delete;
+  ProcessExecutor &operator=(const ProcessExecutor &) = delete;
+
+  ~ProcessExecutor() {
+    for (auto &worker : workers_) {
+      if (worker.pid <= 0)
+        continue;
+      uint32_t stop = stopCommand;
+      sendAll(worker.socket, &stop, sizeof(stop));
+    }
+    for (auto &worker : workers_)
+      reap(worker, false);
+  }
+
+  uint32_t workers() const { return static_cast<uint32_t>(workers_.size()); }
+
+  // runs every pass once, throws when a pass keeps failing
+  Report run() {
+    using Clock = std::chrono::steady_clock;
+    const auto &passes = graph_.passes();
+    auto begin = Clock::now();
+
+    Report report;
+    report.passes.resize(passes.size());
+    std::vector<uint32_t> waiting(passes.size());
+    std::vector<std::vector<PassId>> dependents(passes.size());
+    std::deque<PassId> ready;
+    for (PassId id = 0; id < passes.size(); ++id) {
+      for (PassId dep : graph_.dependencies(id)) {
+        ++waiting[id];
+        dependents[dep].push_back(id);
+      }
+      if (waiting[id] == 0)
+        ready.push_back(id);
+    }
+
+    std::size_t done = 0;
+    std::vector<pollfd> fds(workers_.size());
+    while (done < passes.size()) {
+      // hand ready passes to idle workers
+      for (uint32_t w = 0; w < workers_.size() && !ready.empty(); ++w) {
+        auto &worker = workers_[w];
+        if (worker.busy != idle)
+          continue;
+        PassId id = ready.front();
+        ready.pop_front();
+        ++report.passes[id].attempts;
+        worker.busy = id;
+        worker.started = Clock::now();
+        if (!sendAll(worker.socket, &id, sizeof(id)))
+          fail(worker, w, ready, report); // died while idle
+      }
+      if (ready.empty() && !anyBusy())
+        throw std::logic_error("ProcessGraph has a dependency cycle");
+
+      for (uint32_t w = 0; w < workers_.size(); ++w)
+        fds[w] = {workers_[w].socket, POLLIN, 0};
+      int timeout = passTimeout.count() > 0
+                        ? static_cast<int>(passTimeout.count() / 4 + 1)
+                        : -1;
+      int n = ::poll(fds.data(), fds.size(), timeout);
+      if (n < 0 && errno != EINTR)
+        throw std::system_error(errno, std::generic_category(), "poll");
+
+      for (uint32_t w = 0; w < workers_.size(); ++w) {
+        auto &worker = workers_[w];
+        if (worker.busy == idle) {
+          // an idle worker has nothing to say: readable or hung up means
+          // it died, and left in the poll set it would wake every poll
+          if (fds[w].revents & (POLLIN | POLLHUP | POLLERR))
+            fail(worker, w, ready, report);
+          continue;
+        }
+        if (fds[w].revents & (POLLIN | POLLHUP | POLLERR)) {
+          Message message;
+          if (receiveAll(worker.socket, &message, sizeof(message)) &&
+              message.pass == worker.busy && message.status == 0) {
+            PassId id = worker.busy;
+            auto &pass = report.passes[id];
+            pass.worker = w;
+            pass.ms = std::chrono::duration<double, std::milli>(
+                          Clock::now() - worker.started)
+                          .count();
+            worker.busy = idle;
+            ++done;
+            for (PassId next : dependents[id])
+              if (--waiting[next] == 0)
+                ready.push_back(next);
+            continue;
+          }
+          // kernel threw, or the worker is gone
+          fail(worker, w, ready, report);
+        } else if (passTimeout.count() > 0 &&
+                   Clock::now() - worker.started > passTimeout) {
+          ::kill(worker.pid, SIGKILL);
+          fail(worker, w, ready, report);
+        }
+      }
+    }
+
+    report.ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - begin)
+            .count();
+    return report;
+  }
+
+private:
+  static constexpr uint32_t stopCommand = ~0u;
+  static constexpr PassId idle = ~0u;
+
+  struct Message {
+    PassId pass;
+    uint32_t status; // 0 ok, 1 kernel threw
+  };
+
+  struct Worker {
+    pid_t pid = -1;
+    int socket = -1; // commands in, results out
+    PassId busy = idle;
+    std::chrono::steady_clock::time_point started;
+  };
+
+  const ProcessGraph &graph_;
+  std::vector<Worker> workers_;
+
+  bool anyBusy() const {
+    for (const auto &worker : workers_)
+      if (worker.busy != idle)
+        return true;
+    return false;
+  }
+
+  static bool receiveAll(int fd, void *data, std::size_t size) {
+    auto p = static_cast<char *>(data);
+    while (size > 0) {
+      ssize_t n = ::recv(fd, p, size, 0);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  // a dead peer is an error here, not a SIGPIPE
+  static bool sendAll(int fd, const void *data, std::size_t size) {
+    auto p = static_cast<const char *>(data);
+    while (size > 0) {
+      ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  // retry the pass of a failed worker elsewhere and replace the worker
+  void fail(Worker &worker, uint32_t index, std::deque<PassId> &ready,
+            Report &report) {
+    PassId id = worker.busy;
+    ++report.workerFailures;
+    reap(worker, true);
+    spawn(index);
+    if (id == idle)
+      return;
+    if (report.passes[id].attempts >= maxAttempts)
+      throw std::runtime_error("pass " + graph_.passes()[id].name +
+                               " failed " + std::to_string(maxAttempts) +
+                               " times");
+    ready.push_front(id);
+  }
+
+  void reap(Worker &worker, bool force) {
+    if (worker.pid > 0) {
+      if (force)
+        ::kill(worker.pid, SIGKILL);
+      int status;
+      while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR)
+        ;
+    }
+    if (worker.socket >= 0)
+      ::close(worker.socket);
+    worker = Worker{};
+  }
+
+  void spawn(uint32_t index) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) != 0)
+      throw std::system_error(errno, std::generic_category(), "socketpair");
+    pid_t pid = fork();
+    if (pid < 0) {
+      int error = errno;
+      ::close(sockets[0]);
+      ::close(sockets[1]);
+      throw std::system_error(error, std::generic_category(), "fork");
+    }
+    if (pid == 0) {
+      ::close(sockets[0]);
+      for (const auto &other : workers_) // sockets of the sibling workers
+        if (other.socket >= 0)
+          ::close(other.socket);
+      serve(sockets[1]);
+    }
+    ::close(sockets[1]);
+    auto &worker = workers_[index];
+    worker.pid = pid;
+    worker.socket = sockets[0];
+    worker.busy = idle;
+  }
+
+  // worker main loop, never returns
+  [[noreturn]] void serve(int socket) {
+    const auto &passes = graph_.passes();
+    PassId id;
+    while (receiveAll(socket, &id, sizeof(id)) && id != stopCommand) {
+      Message message{id, 0};
+      try {
+        const auto &pass = passes.at(id);
+        PassContext context(graph_.buffers(), pass.reads, pass.writes);
+        pass.kernel(context);
+      } catch (...) {
+        message.status = 1;
+      }
+      if (!sendAll(socket, &message, sizeof(message)))
+        break;
+    }
+    _exit(0);
+  }
+};
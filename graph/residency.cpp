@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "residency.hpp"
+
+// the hair simulation of graph.hpp with real payloads: positions and
+// velocities are touched by every pass, density only every few frames and
+// the colorMap only by the first G-buffer pass; the manager compresses what
+// goes cold between uses and brings it back on the next access
+
+constexpr std::size_t strands = 4u << 20;
+
+template <typename F> void forEach(ResidencyManager::Access &a, F &&f) {
+  auto data = a.as<float>();
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = f(i, data[i]);
+}
+
+// residency [frames] [coldAfter ticks]
+int main(int argc, char *argv[]) {
+  int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 16;
+  uint64_t coldAfter = argc > 2 ? std::max(1, std::atoi(argv[2])) : 4;
+
+  ResidencyManager residency({.coldAfter = coldAfter});
+  const ImageData colorMapData{2048, 2048, 1, 0, 0};
+  IResourceNode<ImageData> colorMap(
+      colorMapData, NamingPool::getName("colorMap"),
+      residency.allocate(byteSize(colorMapData)));
+  auto buffer = [&](std::string_view name, Codec codec) {
+    BufferData data{static_cast<uint32_t>(strands * sizeof(float)), 0};
+    return IResourceNode<BufferData>(data, NamingPool::getName(name),
+                                     residency.allocate(data.size, codec));
+  };
+  auto hairPos = buffer("hairPos", Codec::Floats);
+  auto hairVel = buffer("hairVel", Codec::Floats);
+  auto hairDensity = buffer("hairDensity", Codec::Floats);
+  auto hairMass = buffer("hairMass", Codec::Floats);
+
+  // load
+  {
+    auto pixelsAccess = residency.access(colorMap.resource);
+    auto pixels = pixelsAccess.as<uint8_t>();
+    for (std::size_t i = 0; i < pixels.size(); ++i)
+      pixels[i] = static_cast<uint8_t>((i / 4 % 2048) / 8 + (i % 4) * 32);
+    auto pos = residency.access(hairPos.resource);
+    forEach(pos, [](std::size_t i, float) { return 0.01f * (i % 4096); });
+    auto mass = residency.access(hairMass.resource);
+    forEach(mass,
+            [](std::size_t i, float) { return 1.0f + 0.001f * (i % 64); });
+  }
+  residency.tick();
+
+  // G-buffer pass, the last reader of colorMap; what it read is kept to
+  // check the payload against once it has been cold
+  std::vector<std::byte> colorCopy;
+  {
+    auto pixels = residency.access(colorMap.resource);
+    colorCopy.assign(pixels.bytes().begin(), pixels.bytes().end());
+  }
+  residency.tick();
+
+  std::vector<float> massCopy(strands), densityCopy(strands);
+  {
+    auto mass = residency.access(hairMass.resource);
+    std::memcpy(massCopy.data(), mass.bytes().data(), mass.bytes().size());
+  }
+
+  for (int frame = 0; frame < frames; ++frame) {
+    // advection
+    {
+      auto posAccess = residency.access(hairPos.resource);
+      auto pos = posAccess.as<float>();
+      auto velAccess = residency.access(hairVel.resource);
+      auto vel = velAccess.as<float>();
+      auto massAccess = residency.access(hairMass.resource);
+      auto mass = massAccess.as<float>();
+      for (std::size_t i = 0; i < strands; ++i)
+        pos[i] += 0.016f * vel[i] / mass[i];
+    }
+    residency.tick();
+    // constraints and collision
+    {
+      auto posAccess = residency.access(hairPos.resource);
+      auto pos = posAccess.as<float>();
+      auto velAccess = residency.access(hairVel.resource);
+      auto vel = velAccess.as<float>();
+      for (std::size_t i = 0; i < strands; ++i) {
+        if (pos[i] < 0) {
+          pos[i] = 0;
+          vel[i] = -0.5f * vel[i];
+        }
+        vel[i] -= 0.016f * 9.81f;
+      }
+    }
+    residency.tick();
+    // internal forces, density is refreshed every 8th frame only
+    {
+      auto posAccess = residency.access(hairPos.resource);
+      auto pos = posAccess.as<float>();
+      auto velAccess = residency.access(hairVel.resource);
+      auto vel = velAccess.as<float>();
+      if (frame % 8 == 0) {
+        auto densityAccess = residency.access(hairDensity.resource);
+        auto density = densityAccess.as<float>();
+        for (std::size_t i = 1; i < strands; ++i)
+          density[i] =
+              0.5f * density[i] + 0.5f * std::abs(pos[i] - pos[i - 1]);
+        std::copy(density.begin(), density.end(), densityCopy.begin());
+      }
+      for (std::size_t i = 0; i < strands; ++i)
+        vel[i] *= 0.99f;
+    }
+    residency.tick();
+  }
+  residency.flush();
+  auto report = residency.report();
+  std::cout << report << std::endl;
+
+  // cold payloads come back bit exact
+  auto intact = [&](GPUResource resource, const void *copy) {
+    auto access = residency.access(resource);
+    return std::memcmp(copy, access.bytes().data(), access.bytes().size()) ==
+           0;
+  };
+  bool ok = intact(colorMap.resource, colorCopy.data()) &&
+            intact(hairDensity.resource, densityCopy.data()) &&
+            intact(hairMass.resource, massCopy.data());
+  std::cout << (ok ? "payloads intact" : "payload mismatch") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../others/compress.hpp"
+#include "graph.hpp"
+
+/**
+ compressed residency of cold resource payloads
+
+ 1. ResidencyManager owns the payload bytes behind a GPUResource handle;
+    access() pins the payload and hands out a span, the pass clock (tick(),
+    once per pass) records when it was last used;
+ 2. a background thread compresses payloads that are unpinned and have not
+    been used for coldAfter ticks: chunk by chunk with the LZ codec of
+    others/compress.hpp, Codec::Floats runs the delta / byte plane transform
+    first (simulation buffers, maps of smooth values); chunks that do not
+    shrink are kept as they are; the raw bytes are freed once all chunks
+    are done;
+ 3. access() to a cold payload decompresses it on the calling thread, an
+    access during compression asks the compressor to give up at the next
+    chunk and waits for that; both count as stall time;
+ 4. report() gives resident bytes against raw bytes, the compression ratio
+    of what was compressed and the time spent compressing and stalled.
+*/
+
+enum class Codec { Bytes, Floats };
+
+struct ResidencyOptions {
+  uint64_t coldAfter = 2;          // ticks without access before compressing
+  std::size_t chunk = 256u << 10;  // compressed independently, bounds a stall
+};
+
+struct ResidencyReport {
+  uint64_t buffers = 0;
+  uint64_t cold = 0;
+  uint64_t rawBytes = 0;      // all payloads uncompressed
+  uint64_t residentBytes = 0; // what they take now
+  uint64_t peakResidentBytes = 0;
+  uint64_t compressions = 0;
+  uint64_t decompressions = 0;
+  uint64_t abandoned = 0;      // compressions given up for an access
+  uint64_t bytesCompressed = 0; // raw bytes fed to completed compressions
+  uint64_t bytesStored = 0;     // and what they compressed to
+  double compressMs = 0;
+  double stallMs = 0;
+
+  double ratio() const {
+    return bytesStored ? double(bytesCompressed) / bytesStored : 1.0;
+  }
+};
+
+inline std::ostream &operator<<(std::ostream &os,
+                                const ResidencyReport &report) {
+  os << report.buffers << " buffers (" << report.cold << " cold), "
+     << report.residentBytes << " of " << report.rawBytes
+     << " bytes resident, peak " << report.peakResidentBytes << "\n"
+     << report.compressions << " compressions (" << report.abandoned
+     << " abandoned), " << report.decompressions << " decompressions, ratio "
+     << report.ratio() << "\n"
+     << "compress " << report.compressMs << " ms in the background, stall "
+     << report.stallMs << " ms";
+  return os;
+}
+
+class ResidencyManager {
+  struct Chunk {
+    std::vector<std::byte> data;
+    bool stored = false; // did not shrink, data is the raw chunk
+  };
+
+  struct Buffer {
+    std::size_t bytes = 0;
+    Codec codec = Codec::Bytes;
+    std::unique_ptr<std::byte[]> raw; // null while cold
+    std::vector<Chunk> chunks;
+    uint64_t lastUse = 0;
+    uint32_t pins = 0;
+    bool compressing = false;
+    bool loading = false;
+    std::atomic<bool> wanted{false};
+    bool live = false;
+  };
+
+public:
+  // pinned payload, the span stays valid until the Access is destroyed
+  class Access {
+    friend class ResidencyManager;
+    ResidencyManager *manager_ = nullptr;
+    uint32_t handle_ = 0;
+    std::span<std::byte> bytes_;
+
+    Access(ResidencyManager *manager, uint32_t handle,
+           std::span<std::byte> bytes)
+        : manager_(manager), handle_(handle), bytes_(bytes) {}
+
+  public:
+    Access(Access &&other) noexcept
+        : manager_(std::exchange(other.manager_, nullptr)),
+          handle_(other.handle_), bytes_(other.bytes_) {}
+    Access &operator=(Access &&other) noexcept {
+      std::swap(manager_, other.manager_);
+      std::swap(handle_, other.handle_);
+      std::swap(bytes_, other.bytes_);
+      return *this;
+    }
+    ~Access() {
+      if (manager_)
+        manager_->unpin(handle_);
+    }
+
+    std::span<std::byte> bytes() const { return bytes_; }
+    template <typename T> std::span<T> as() const {
+      return {reinterpret_cast<T *>(bytes_.data()), bytes_.size() / sizeof(T)};
+    }
+  };
+
+  explicit ResidencyManager(ResidencyOptions options = {})
+      : options_(options) {
+    options_.chunk = std::max<std::size_t>(options_.chunk / 4 * 4, 4);
+    worker_ = std::thread([this] { compressLoop(); });
+  }
+  ResidencyManager(const ResidencyManager &) = delete;
+  ResidencyManager &operator=(const ResidencyManager &) = delete;
+  ~ResidencyManager() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    work_.notify_all();
+    worker_.join();
+  }
+
+  GPUResource allocate(std::size_t bytes, Codec codec = Codec::Bytes) {
+    std::lock_guard lock(mutex_);
+    uint32_t handle;
+    if (!freeList_.empty()) {
+      handle = freeList_.back();
+      freeList_.pop_back();
+    } else {
+      handle = static_cast<uint32_t>(buffers_.size());
+      buffers_.push_back(std::make_unique<Buffer>());
+    }
+    Buffer &b = *buffers_[handle];
+    b.bytes = bytes;
+    b.codec = codec;
+    b.raw = std::make_unique<std::byte[]>(bytes); // zeroed
+    b.chunks.clear();
+    b.lastUse = clock_;
+    b.live = true;
+    resident_ += bytes;
+    peakResident_ = std::max(peakResident_, resident_);
+    return {handle};
+  }
+
+  void free(GPUResource resource) {
+    std::unique_lock lock(mutex_);
+    Buffer &b = buffer(resource.handle);
+    if (b.pins)
+      throw std::logic_error("freeing a pinned resource");
+    settle(b, lock);
+    resident_ -= residentSize(b);
+    b.raw.reset();
+    b.chunks = {};
+    b.live = false;
+    freeList_.push_back(resource.handle);
+  }
+
+  Access access(GPUResource resource) {
+    std::unique_lock lock(mutex_);
+    Buffer &b = buffer(resource.handle);
+    ++b.pins;
+    b.lastUse = clock_;
+    if (b.compressing || b.loading || !b.raw) {
+      auto begin = std::chrono::steady_clock::now();
+      settle(b, lock);
+      if (!b.raw)
+        decompress(b, lock);
+      stallMs_ += std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - begin)
+                      .count();
+    }
+    return Access(this, resource.handle, {b.raw.get(), b.bytes});
+  }
+
+  // one pass is done, payloads idle for coldAfter ticks become candidates
+  void tick() {
+    {
+      std::lock_guard lock(mutex_);
+      ++clock_;
+    }
+    work_.notify_one();
+  }
+
+  // waits until every candidate has been compressed
+  void flush() {
+    std::unique_lock lock(mutex_);
+    work_.notify_one();
+    idle_.wait(lock, [this] { return !busy_ && !candidate(); });
+  }
+
+  ResidencyReport report() const {
+    std::lock_guard lock(mutex_);
+    ResidencyReport report = stats_;
+    for (const auto &b : buffers_) {
+      if (!b->live)
+        continue;
+      ++report.buffers;
+      report.cold += b->raw ? 0 : 1;
+      report.rawBytes += b->bytes;
+    }
+    report.residentBytes = resident_;
+    report.peakResidentBytes = peakResident_;
+    report.stallMs = stallMs_;
+    return report;
+  }
+
+private:
+  Buffer &buffer(uint32_t handle) {
+    if (handle >= buffers_.size() || !buffers_[handle]->live)
+      throw std::out_of_range("unknown resident handle");
+    return *buffers_[handle];
+  }
+
+  static std::size_t residentSize(const Buffer &b) {
+    std::size_t size = b.raw ? b.bytes : 0;
+    for (const Chunk &chunk : b.chunks)
+      size += chunk.data.size();
+    return size;
+  }
+
+  void unpin(uint32_t handle) {
+    std::lock_guard lock(mutex_);
+    Buffer &b = *buffers_[handle];
+    --b.pins;
+    b.lastUse = clock_; // a long pass keeps its payload warm
+    if (!b.pins)
+      work_.notify_one();
+  }
+
+  // waits out a compression (asking it to stop) or another thread's load
+  void settle(Buffer &b, std::unique_lock<std::mutex> &lock) {
+    while (b.compressing || b.loading) {
+      b.wanted = true;
+      done_.wait(lock);
+    }
+    b.wanted = false;
+  }
+
+  // called by access() with b pinned; when decoding throws (allocation, a
+  // corrupt chunk) b stays cold, the pin is dropped and waiters are woken
+  void decompress(Buffer &b, std::unique_lock<std::mutex> &lock) {
+    b.loading = true;
+    lock.unlock();
+    std::unique_ptr<std::byte[]> raw;
+    try {
+      raw = std::make_unique<std::byte[]>(b.bytes);
+      std::vector<std::byte> planes;
+      std::size_t offset = 0;
+      for (const Chunk &chunk : b.chunks) {
+        std::size_t size = std::min(options_.chunk, b.bytes - offset);
+        std::span<std::byte> out(raw.get() + offset, size);
+        if (chunk.stored) {
+          std::copy(chunk.data.begin(), chunk.data.end(), out.begin());
+        } else if (b.codec == Codec::Floats) {
+          planes.resize(size);
+          lzDecompress(chunk.data, planes);
+          floatUnshuffle(planes, out);
+        } else {
+          lzDecompress(chunk.data, out);
+        }
+        offset += size;
+      }
+    } catch (...) {
+      lock.lock();
+      b.loading = false;
+      done_.notify_all();
+      if (--b.pins == 0)
+        work_.notify_one();
+      throw;
+    }
+    lock.lock();
+    resident_ -= residentSize(b);
+    b.raw = std::move(raw);
+    b.chunks = {};
+    resident_ += b.bytes;
+    peakResident_ = std::max(peakResident_, resident_);
+    b.loading = false;
+    ++stats_.decompressions;
+    done_.notify_all();
+  }
+
+  Buffer *candidate() const {
+    Buffer *coldest = nullptr;
+    for (const auto &b : buffers_)
+      if (b->live && b->raw && !b->pins && !b->compressing && !b->loading &&
+          clock_ - b->lastUse >= options_.coldAfter &&
+          (!coldest || b->lastUse < coldest->lastUse))
+        coldest = b.get();
+    return coldest;
+  }
+
+  void compressLoop() {
+    std::unique_lock lock(mutex_);
+    std::vector<std::byte> planes;
+    while (true) {
+      Buffer *b = nullptr;
+      work_.wait(lock, [&] { return stop_ || (b = candidate()); });
+      if (stop_)
+        return;
+      b->compressing = true;
+      busy_ = true;
+      lock.unlock();
+
+      // raw stays valid: access() and free() wait for compressing to clear
+      auto begin = std::chrono::steady_clock::now();
+      std::vector<Chunk> chunks;
+      std::size_t stored = 0;
+      for (std::size_t offset = 0; offset < b->bytes && !b->wanted;
+           offset += options_.chunk) {
+        std::size_t size = std::min(options_.chunk, b->bytes - offset);
+        std::span<const std::byte> in(b->raw.get() + offset, size);
+        Chunk &chunk = chunks.emplace_back();
+        if (b->codec == Codec::Floats) {
+          planes.resize(size);
+          floatShuffle(in, planes);
+          lzCompress(planes, chunk.data);
+        } else {
+          lzCompress(in, chunk.data);
+        }
+        if (chunk.data.size() >= size) {
+          chunk.data.assign(in.begin(), in.end());
+          chunk.stored = true;
+        }
+        chunk.data.shrink_to_fit();
+        stored += chunk.data.size();
+      }
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - begin)
+                      .count();
+
+      lock.lock();
+      stats_.compressMs += ms;
+      if (b->wanted) {
+        ++stats_.abandoned;
+      } else {
+        ++stats_.compressions;
+        stats_.bytesCompressed += b->bytes;
+        stats_.bytesStored += stored;
+        resident_ = resident_ - b->bytes + stored;
+        b->raw.reset();
+        b->chunks = std::move(chunks);
+      }
+      b->compressing = false;
+      busy_ = false;
+      done_.notify_all();
+      idle_.notify_all();
+    }
+  }
+
+  ResidencyOptions options_;
+  mutable std::mutex mutex_;
+  std::condition_variable work_; // compressor: a tick or a flush
+  std::condition_variable done_; // accessors: compression or load finished
+  std::condition_variable idle_; // flush: nothing left to compress
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  std::vector<uint32_t> freeList_;
+  uint64_t clock_ = 0;
+  uint64_t resident_ = 0;
+  uint64_t peakResident_ = 0;
+  double stallMs_ = 0;
+  ResidencyReport stats_;
+  bool busy_ = false;
+  bool stop_ = false;
+  std::thread worker_;
+};
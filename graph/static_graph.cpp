@@ -0,0 +1,128 @@
+#include <array>
+#include <iostream>
+
+#include "graph.hpp"
+#include "static_graph.hpp"
+
+// deferredShading() as a static pipeline: order, culling, lifetimes and
+// memory slots are computed by the compiler, the frame loop walks tables
+
+constexpr PassDecl deferredShadingPasses[] = {
+    {"loadColor", {}, {"colorMap"}},
+    {"loadNormal", {}, {"normalMap"}},
+    {"loadDepth", {}, {"depthMap"}},
+    {"gbuffer",
+     {"colorMap", "normalMap", "depthMap"},
+     {"position", "normal", "albedo", "specular"}},
+    {"lighting", {"position", "normal", "albedo", "specular"}, {"lightMap"}},
+    {"debugView", {"normal"}, {"debugImage"}}, // nobody reads it: culled
+    {"post", {"lightMap"}, {"finalImage"}},
+    {"present", {"finalImage"}, {}, true},
+};
+
+constexpr auto schedule = compileStaticGraph<deferredShadingPasses>();
+static_assert(schedule.steps == 7 && schedule.culled[5]);
+static_assert(schedule.order[3] == 3 && schedule.order[6] == 7);
+static_assert(schedule.slots < schedule.resourceCount);
+
+#if defined(STATIC_GRAPH_BROKEN)
+// does not compile: "lightMap" has no producer
+constexpr PassDecl brokenPasses[] = {{"post", {"lightMap"}, {"finalImage"}},
+                                     {"present", {"finalImage"}, {}, true}};
+constexpr auto broken = compileStaticGraph<brokenPasses>();
+#endif
+
+using ImageNode = IResourceNode<ImageData>;
+
+struct Frame {
+  std::array<Optional<ImageNode>, schedule.resourceCount> nodes;
+  uint32_t live = 0;
+  uint32_t peak = 0;
+
+  const ImageNode &get(uint32_t r) const { return *nodes[r]; }
+  void set(uint32_t r, const ImageNode &node) {
+    nodes[r].emplace(node);
+    peak = std::max(peak, ++live);
+  }
+
+  void run(uint32_t pass);
+  void release(uint32_t r) {
+    nodes[r].reset();
+    --live;
+  }
+};
+
+template <std::size_t N> constexpr uint32_t id(const char (&name)[N]) {
+  return schedule.resource(std::string_view(name, N - 1));
+}
+
+// passes[p] implements deferredShadingPasses[p]
+constexpr std::array<void (*)(Frame &), std::size(deferredShadingPasses)>
+    passes = {
+        [](Frame &f) {
+          f.set(id("colorMap"), LoadFunctor<ImageData>()(
+                                    surrogateResourceData<ImageData>("color")));
+        },
+        [](Frame &f) {
+          f.set(id("normalMap"),
+                LoadFunctor<ImageData>()(
+                    surrogateResourceData<ImageData>("normal")));
+        },
+        [](Frame &f) {
+          f.set(id("depthMap"), LoadFunctor<ImageData>()(
+                                    surrogateResourceData<ImageData>("depth")));
+        },
+        [](Frame &f) {
+          auto [position, normal, albedo, specular] = DeferredShadingFunctor()(
+              {f.get(id("colorMap")), f.get(id("normalMap")),
+               f.get(id("depthMap"))});
+          f.set(id("position"), position);
+          f.set(id("normal"), normal);
+          f.set(id("albedo"), albedo);
+          f.set(id("specular"), specular);
+        },
+        [](Frame &f) {
+          auto [lightMap] = LightingPassFunctor()(
+              {f.get(id("position")), f.get(id("normal")),
+               f.get(id("albedo")), f.get(id("specular"))});
+          f.set(id("lightMap"), lightMap);
+        },
+        [](Frame &) { std::cout << "debug view" << std::endl; },
+        [](Frame &f) {
+          auto [finalImage] = PostProcessingFunctor()({f.get(id("lightMap"))});
+          f.set(id("finalImage"), finalImage);
+        },
+        [](Frame &f) { PresentFunctor()({f.get(id("finalImage"))}); },
+};
+
+void Frame::run(uint32_t pass) { passes[pass](*this); }
+
+int main() {
+  std::cout << "static schedule:";
+  for (std::size_t step = 0; step < schedule.steps; ++step)
+    std::cout << " " << deferredShadingPasses[schedule.order[step]].name;
+  std::cout << std::endl;
+  for (uint32_t r = 0; r < schedule.resourceCount; ++r) {
+    std::cout << "  " << schedule.resources[r];
+    if (schedule.firstStep[r] == noIndex)
+      std::cout << ": culled" << std::endl;
+    else
+      std::cout << ": steps " << schedule.firstStep[r] << "-"
+                << schedule.lastStep[r] << ", slot " << schedule.slot[r]
+                << std::endl;
+  }
+  std::cout << schedule.slots << " slots for " << schedule.resourceCount
+            << " resources" << std::endl;
+
+  DoubleBufferedArena arenas;
+  for (uint32_t frame = 0; frame < 2; ++frame) {
+    FrameScope scope(arenas.flip());
+    NamingPool::reset();
+    Frame state;
+    runStaticGraph<schedule>(state);
+    std::cout << "frame " << frame << ": at most " << state.peak
+              << " resources alive, " << state.live << " left" << std::endl;
+  }
+  NamingPool::release();
+  return 0;
+}
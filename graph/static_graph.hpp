@@ -0,0 +1,245 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+/**
+ graph compilation at compile time, for pipelines fixed in the source
+
+ 1. a pipeline is a constexpr array of PassDecl, resources are named by the
+    passes reading and writing them, output passes (present, store) have
+    side effects and are never culled;
+ 2. compileStaticGraph<passes>() is consteval and yields a StaticSchedule:
+    execution order, culled passes, producer and lifetime of every resource,
+    a memory slot per resource (transients with disjoint lifetimes share a
+    slot) and per step tables of the resources to release afterwards;
+ 3. a resource read but never written, one written twice or a cycle fails
+    the constant evaluation, so a broken pipeline does not compile;
+ 4. runStaticGraph() only walks the precomputed arrays.
+
+ usage:
+    constexpr PassDecl passes[] = {{"load", {}, {"color"}},
+                                   {"present", {"color"}, {}, true}};
+    constexpr auto schedule = compileStaticGraph<passes>();
+    static_assert(schedule.steps == 2);
+*/
+
+inline constexpr std::size_t maxPassIo = 8;
+
+struct PassDecl {
+  std::string_view name;
+  std::array<std::string_view, maxPassIo> reads{};
+  std::array<std::string_view, maxPassIo> writes{};
+  bool output = false;
+};
+
+inline constexpr uint32_t noIndex = ~0u;
+
+template <std::size_t P, std::size_t R> struct StaticSchedule {
+  static constexpr std::size_t passCount = P;
+  static constexpr std::size_t resourceCount = R;
+
+  // declaration indices of the live passes in execution order
+  std::array<uint32_t, P> order{};
+  std::size_t steps = 0;
+  std::array<bool, P> culled{};
+
+  std::array<std::string_view, R> resources{};
+  std::array<uint32_t, R> producer{};  // declaration index of the writer
+  std::array<uint32_t, R> firstStep{}; // noIndex when culled with its writer
+  std::array<uint32_t, R> lastStep{};
+  std::array<uint32_t, R> slot{};
+  std::size_t slots = 0;
+
+  // resources to release after step s: release[releaseBegin[s] ...
+  // releaseBegin[s + 1])
+  std::array<uint32_t, R> release{};
+  std::array<uint32_t, P + 1> releaseBegin{};
+
+  // throws, which fails a constant evaluation, when name is unknown
+  constexpr uint32_t resource(std::string_view name) const {
+    for (uint32_t r = 0; r < R; ++r)
+      if (resources[r] == name)
+        return r;
+    throw std::logic_error("static graph: unknown resource");
+  }
+};
+
+namespace static_graph_detail {
+
+template <std::size_t P>
+constexpr bool contains(const std::array<std::string_view, P> &names,
+                        std::size_t count, std::string_view name) {
+  for (std::size_t i = 0; i < count; ++i)
+    if (names[i] == name)
+      return true;
+  return false;
+}
+
+// reads first, then writes
+template <typename F> constexpr void forEachName(const PassDecl &pass, F f) {
+  for (std::size_t i = 0; i < maxPassIo; ++i)
+    if (!pass.reads[i].empty())
+      f(pass.reads[i]);
+  for (std::size_t i = 0; i < maxPassIo; ++i)
+    if (!pass.writes[i].empty())
+      f(pass.writes[i]);
+}
+
+// number of distinct resource names of a pipeline
+template <std::size_t P>
+consteval std::size_t countResources(const PassDecl (&passes)[P]) {
+  std::array<std::string_view, P * 2 * maxPassIo> seen{};
+  std::size_t count = 0;
+  for (std::size_t p = 0; p < P; ++p)
+    forEachName(passes[p], [&](std::string_view name) {
+      if (!contains(seen, count, name))
+        seen[count++] = name;
+    });
+  return count;
+}
+
+} // namespace static_graph_detail
+
+namespace static_graph_detail {
+
+template <std::size_t R, std::size_t P>
+consteval StaticSchedule<P, R> compile(const PassDecl (&Passes)[P]) {
+  StaticSchedule<P, R> s;
+
+  // resources in order of first mention, and their producers
+  std::size_t count = 0;
+  for (std::size_t p = 0; p < P; ++p)
+    static_graph_detail::forEachName(Passes[p], [&](std::string_view name) {
+      if (!static_graph_detail::contains(s.resources, count, name)) {
+        s.producer[count] = noIndex;
+        s.resources[count++] = name;
+      }
+    });
+  for (uint32_t p = 0; p < P; ++p)
+    for (std::size_t i = 0; i < maxPassIo; ++i)
+      if (!Passes[p].writes[i].empty()) {
+        uint32_t r = s.resource(Passes[p].writes[i]);
+        if (s.producer[r] != noIndex)
+          throw std::logic_error("static graph: resource written twice");
+        s.producer[r] = p;
+      }
+  for (uint32_t p = 0; p < P; ++p)
+    for (std::size_t i = 0; i < maxPassIo; ++i)
+      if (!Passes[p].reads[i].empty() &&
+          s.producer[s.resource(Passes[p].reads[i])] == noIndex)
+        throw std::logic_error("static graph: missing producer");
+
+  // topological order, ties broken by declaration order
+  std::array<uint32_t, P> topo{};
+  std::array<bool, P> placed{};
+  for (std::size_t placedCount = 0; placedCount < P; ++placedCount) {
+    uint32_t next = noIndex;
+    for (uint32_t p = 0; p < P && next == noIndex; ++p) {
+      if (placed[p])
+        continue;
+      bool ready = true;
+      for (std::size_t i = 0; i < maxPassIo; ++i)
+        if (!Passes[p].reads[i].empty() &&
+            !placed[s.producer[s.resource(Passes[p].reads[i])]])
+          ready = false;
+      if (ready)
+        next = p;
+    }
+    if (next == noIndex)
+      throw std::logic_error("static graph: dependency cycle");
+    placed[next] = true;
+    topo[placedCount] = next;
+  }
+
+  // culling, backwards: a pass lives when it is an output or writes a
+  // resource a live pass reads
+  std::array<bool, P> live{};
+  std::array<bool, R> needed{};
+  for (std::size_t step = P; step-- > 0;) {
+    uint32_t p = topo[step];
+    live[p] = Passes[p].output;
+    for (std::size_t i = 0; i < maxPassIo; ++i)
+      if (!Passes[p].writes[i].empty() &&
+          needed[s.resource(Passes[p].writes[i])])
+        live[p] = true;
+    if (live[p])
+      for (std::size_t i = 0; i < maxPassIo; ++i)
+        if (!Passes[p].reads[i].empty())
+          needed[s.resource(Passes[p].reads[i])] = true;
+  }
+  for (uint32_t i = 0; i < P; ++i) {
+    s.culled[i] = !live[i];
+    if (live[topo[i]])
+      s.order[s.steps++] = topo[i];
+  }
+
+  // lifetimes in steps: from the producing step to the last reading step
+  for (uint32_t r = 0; r < R; ++r)
+    s.firstStep[r] = s.lastStep[r] = noIndex;
+  for (uint32_t step = 0; step < s.steps; ++step) {
+    static_graph_detail::forEachName(
+        Passes[s.order[step]], [&](std::string_view name) {
+          uint32_t r = s.resource(name);
+          if (s.firstStep[r] == noIndex)
+            s.firstStep[r] = step;
+          s.lastStep[r] = step;
+        });
+  }
+
+  // slots: greedy interval colouring in step order
+  std::array<uint32_t, R> slotFreeAfter{}; // last step of the slot's holder
+  for (uint32_t step = 0; step < s.steps; ++step)
+    for (uint32_t r = 0; r < R; ++r) {
+      if (s.firstStep[r] != step)
+        continue;
+      uint32_t slot = noIndex;
+      for (uint32_t k = 0; k < s.slots && slot == noIndex; ++k)
+        if (slotFreeAfter[k] < step)
+          slot = k;
+      if (slot == noIndex)
+        slot = static_cast<uint32_t>(s.slots++);
+      s.slot[r] = slot;
+      slotFreeAfter[slot] = s.lastStep[r];
+    }
+  for (uint32_t r = 0; r < R; ++r)
+    if (s.firstStep[r] == noIndex)
+      s.slot[r] = noIndex;
+
+  // release tables
+  std::size_t released = 0;
+  for (uint32_t step = 0; step < s.steps; ++step) {
+    s.releaseBegin[step] = static_cast<uint32_t>(released);
+    for (uint32_t r = 0; r < R; ++r)
+      if (s.lastStep[r] == step)
+        s.release[released++] = r;
+  }
+  for (std::size_t step = s.steps; step <= P; ++step)
+    s.releaseBegin[step] = static_cast<uint32_t>(released);
+  return s;
+}
+
+} // namespace static_graph_detail
+
+template <const auto &Passes> consteval auto compileStaticGraph() {
+  return static_graph_detail::compile<
+      static_graph_detail::countResources(Passes)>(Passes);
+}
+
+/**
+ runs a compiled pipeline, passes[p] implements declaration p:
+    context.run(p) for every step, then context.release(r) for every resource
+    whose lifetime ends with that step
+*/
+template <const auto &Schedule, typename Context>
+void runStaticGraph(Context &context) {
+  for (std::size_t step = 0; step < Schedule.steps; ++step) {
+    context.run(Schedule.order[step]);
+    for (uint32_t i = Schedule.releaseBegin[step];
+         i < Schedule.releaseBegin[step + 1]; ++i)
+      context.release(Schedule.release[i]);
+  }
+}
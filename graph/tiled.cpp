@@ -0,0 +1,132 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "tiled.hpp"
+
+// a scan -> 3x3x3 box blur -> gradient magnitude chain over a float volume
+// streamed through a mapped tile budget far smaller than the volume; the
+// blur reads one tile around its output, the gradient one tile in x and y
+
+float scanValue(uint32_t x, uint32_t y, uint32_t z) {
+  return std::sin(0.05f * x) * std::cos(0.03f * y) + 0.01f * z;
+}
+
+float blurred(uint32_t x, uint32_t y, uint32_t z, const ImageData &extent) {
+  auto clamp = [](int64_t v, uint32_t n) {
+    return static_cast<uint32_t>(std::clamp<int64_t>(v, 0, n - 1));
+  };
+  float sum = 0;
+  for (int dz = -1; dz <= 1; ++dz)
+    for (int dy = -1; dy <= 1; ++dy)
+      for (int dx = -1; dx <= 1; ++dx)
+        sum += scanValue(clamp(int64_t(x) + dx, extent.width),
+                         clamp(int64_t(y) + dy, extent.height),
+                         clamp(int64_t(z) + dz, extent.depth));
+  return sum / 27;
+}
+
+bool run(uint32_t depth, uint64_t budget) {
+  const ImageData extent{1024, 1024, depth, 0, 0};
+  TiledGraph graph(extent, {64, 64, 4}, {.budget = budget});
+  ResourceId scan = graph.addResource("scan");
+  ResourceId blur = graph.addResource("blur");
+  ResourceId gradient = graph.addResource("gradient");
+
+  // stands in for importRaw() of a real scan
+  graph.addPass("acquire", {}, {scan}, [](const TileContext &tile) {
+    const auto &r = tile.region;
+    for (uint32_t z = r.z0; z < r.z1; ++z)
+      for (uint32_t y = r.y0; y < r.y1; ++y)
+        for (uint32_t x = r.x0; x < r.x1; ++x)
+          tile.output(0)(x, y, z) = scanValue(x, y, z);
+  });
+  graph.addPass("blur", {{scan, {1, 1, 1}}}, {blur},
+                [](const TileContext &tile) {
+                  const auto &r = tile.region;
+                  const TileInput &in = tile.input(0);
+                  for (uint32_t z = r.z0; z < r.z1; ++z)
+                    for (uint32_t y = r.y0; y < r.y1; ++y)
+                      for (uint32_t x = r.x0; x < r.x1; ++x) {
+                        float sum = 0;
+                        for (int dz = -1; dz <= 1; ++dz)
+                          for (int dy = -1; dy <= 1; ++dy)
+                            for (int dx = -1; dx <= 1; ++dx)
+                              sum += in(int64_t(x) + dx, int64_t(y) + dy,
+                                        int64_t(z) + dz);
+                        tile.output(0)(x, y, z) = sum / 27;
+                      }
+                });
+  graph.addPass("gradient", {{blur, {1, 1, 0}}}, {gradient},
+                [](const TileContext &tile) {
+                  const auto &r = tile.region;
+                  const TileInput &in = tile.input(0);
+                  for (uint32_t z = r.z0; z < r.z1; ++z)
+                    for (uint32_t y = r.y0; y < r.y1; ++y)
+                      for (uint32_t x = r.x0; x < r.x1; ++x) {
+                        float gx = in(int64_t(x) + 1, y, z) -
+                                   in(int64_t(x) - 1, y, z);
+                        float gy = in(x, int64_t(y) + 1, z) -
+                                   in(x, int64_t(y) - 1, z);
+                        tile.output(0)(x, y, z) = std::sqrt(gx * gx + gy * gy);
+                      }
+                });
+
+  std::cout << "volume " << extent.width << "x" << extent.height << "x"
+            << extent.depth << ", " << byteSize(extent)
+            << " bytes per resource, "
+            << graph.tileCount() << " tiles of " << graph.tileBytes()
+            << " bytes, budget " << budget << " bytes" << std::endl;
+  std::cout << graph.run() << std::endl;
+
+  // spot checks against the direct computation, including tile borders
+  bool ok = true;
+  const uint32_t samples[][3] = {{0, 0, 0},
+                                 {63, 64, 3},
+                                 {64, 63, 4},
+                                 {511, 700, depth / 2},
+                                 {1023, 1023, depth - 1}};
+  for (const auto &s : samples) {
+    uint32_t x = s[0], y = s[1], z = std::min(s[2], depth - 1);
+    float expected = blurred(x, y, z, extent);
+    ok &= std::abs(graph.at(blur, x, y, z) - expected) < 1e-5f;
+    auto b = [&](int64_t bx, int64_t by) {
+      return blurred(std::clamp<int64_t>(bx, 0, extent.width - 1),
+                     std::clamp<int64_t>(by, 0, extent.height - 1), z, extent);
+    };
+    float gx = b(int64_t(x) + 1, y) - b(int64_t(x) - 1, y);
+    float gy = b(x, int64_t(y) + 1) - b(x, int64_t(y) - 1);
+    ok &= std::abs(graph.at(gradient, x, y, z) -
+                   std::sqrt(gx * gx + gy * gy)) < 1e-4f;
+  }
+
+  // the gradient out to a raw file and back into a resource of its own
+  std::string raw = "/var/tmp/tiled." + std::to_string(getpid()) + ".raw";
+  graph.exportRaw(gradient, raw);
+  ResourceId reloaded = graph.addResource("reloaded");
+  graph.importRaw(reloaded, raw);
+  std::remove(raw.c_str());
+  for (const auto &s : samples) {
+    uint32_t x = s[0], y = s[1], z = std::min(s[2], depth - 1);
+    ok &= graph.at(reloaded, x, y, z) == graph.at(gradient, x, y, z);
+  }
+  std::cout << (ok ? "check ok" : "check failed") << std::endl;
+  return ok;
+}
+
+// tiled [depth] [budget MiB]
+int main(int argc, char *argv[]) {
+  uint32_t depth = argc > 1 ? std::max(1, std::atoi(argv[1])) : 16;
+  uint64_t budget = uint64_t(argc > 2 ? std::max(1, std::atoi(argv[2])) : 16)
+                    << 20;
+  try {
+    return run(depth, budget) ? 0 : 1;
+  } catch (const std::exception &ex) {
+    // e.g. a budget too small for the tiles one pass needs
+    std::cerr << "tiled: " << ex.what() << '\n';
+    return 2;
+  }
+}
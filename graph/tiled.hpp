@@ -0,0 +1,587 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graph.hpp"
+
+/**
+ out of core tiled execution (POSIX)
+
+ 1. a TiledGraph works on resources larger than RAM: float volumes sharing
+    one extent (ImageData width x height x depth, or a BufferData seen as
+    size / 4 elements along x, so below 4 GiB) split into tiles of a fixed
+    shape; every resource is a file, tile after tile, each tile padded to
+    whole pages so it can be mapped on its own;
+ 2. a pass declares the footprint of each read as a halo in elements: to
+    produce an output tile it may look that far into the neighbouring tiles
+    of the input (at most one tile in each direction), reads outside the
+    volume are clamped to its border;
+ 3. run() streams the tiles through the whole pass chain in file order, pass
+    p works lag[p] tiles behind the first pass, where the lag is just large
+    enough for every neighbour tile it reads to be written already; the
+    working set is a band of tiles instead of whole resources;
+ 4. mapped tiles are kept in an LRU cache bounded by Options::budget bytes,
+    the least recently used unpinned tile is unmapped when room is needed
+    (dirty pages go back to the file through the page cache); run() throws
+    if one pass needs more tiles than the budget holds;
+ 5. after each step the tiles read by the next prefetch steps are mapped and
+    madvise(MADV_WILLNEED)d so the kernel reads them ahead while the
+    current step computes.
+
+ intermediates and resources created without a path are unlinked temporary
+ files in Options::scratch; keep it on disk, /tmp is often a tmpfs.
+*/
+
+using ResourceId = uint32_t;
+using PassId = uint32_t;
+
+struct TileShape {
+  uint32_t width = 64;
+  uint32_t height = 64;
+  uint32_t depth = 1;
+};
+
+// element box [x0, x1) x [y0, y1) x [z0, z1) in volume coordinates
+struct TileRegion {
+  uint32_t x0, y0, z0;
+  uint32_t x1, y1, z1;
+};
+
+// how far around the output tile a pass reads an input
+struct Footprint {
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t z = 0;
+};
+
+struct TiledRead {
+  ResourceId resource;
+  Footprint footprint = {};
+};
+
+// read access to an input around the tile being produced
+class TileInput {
+  friend class TiledGraph;
+
+  const float *tiles_[27] = {}; // 3x3x3 neighbourhood, 13 is the centre
+  TileRegion centre_ = {};
+  TileShape shape_ = {};
+  uint32_t extent_[3] = {};
+
+public:
+  // element at volume coordinates, clamped to the volume; must lie inside
+  // the declared footprint
+  float operator()(int64_t x, int64_t y, int64_t z) const {
+    x = std::clamp<int64_t>(x, 0, extent_[0] - 1);
+    y = std::clamp<int64_t>(y, 0, extent_[1] - 1);
+    z = std::clamp<int64_t>(z, 0, extent_[2] - 1);
+    int dx = x < centre_.x0 ? 0 : x >= centre_.x0 + shape_.width ? 2 : 1;
+    int dy = y < centre_.y0 ? 0 : y >= centre_.y0 + shape_.height ? 2 : 1;
+    int dz = z < centre_.z0 ? 0 : z >= centre_.z0 + shape_.depth ? 2 : 1;
+    int64_t lx = x - centre_.x0 - (dx - 1) * int64_t(shape_.width);
+    int64_t ly = y - centre_.y0 - (dy - 1) * int64_t(shape_.height);
+    int64_t lz = z - centre_.z0 - (dz - 1) * int64_t(shape_.depth);
+    return tiles_[dx + 3 * (dy + 3 * dz)]
+                 [lx + shape_.width * (ly + shape_.height * lz)];
+  }
+
+  // the centre tile, same layout as TileOutput::data()
+  const float *data() const { return tiles_[13]; }
+};
+
+// the output tile, elements x fastest with the full tile shape as stride
+class TileOutput {
+  friend class TiledGraph;
+
+  float *data_ = nullptr;
+  TileRegion region_ = {};
+  TileShape shape_ = {};
+
+public:
+  float &operator()(uint32_t x, uint32_t y, uint32_t z) const {
+    return data_[(x - region_.x0) +
+                 shape_.width * ((y - region_.y0) +
+                                 shape_.height * (z - region_.z0))];
+  }
+  float *data() const { return data_; }
+};
+
+struct TileContext {
+  TileRegion region; // may be smaller than the shape at the volume border
+  TileShape shape;
+  std::span<const TileInput> inputs;
+  std::span<const TileOutput> outputs;
+
+  const TileInput &input(std::size_t i) const { return inputs[i]; }
+  const TileOutput &output(std::size_t i) const { return outputs[i]; }
+  // offset of (x, y, z) in data() of the centre or output tile
+  std::size_t index(uint32_t x, uint32_t y, uint32_t z) const {
+    return (x - region.x0) +
+           std::size_t(shape.width) *
+               ((y - region.y0) + std::size_t(shape.height) * (z - region.z0));
+  }
+};
+
+struct TiledReport {
+  uint64_t steps = 0;
+  uint64_t tileRuns = 0;   // pass x tile kernel calls
+  uint64_t hits = 0;       // tile already mapped
+  uint64_t maps = 0;       // tile mapped on demand
+  uint64_t prefetches = 0; // tile mapped ahead with MADV_WILLNEED
+  uint64_t evictions = 0;
+  uint64_t peakMapped = 0;
+  uint64_t budget = 0;
+  double ms = 0;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const TiledReport &report) {
+  os << report.steps << " steps, " << report.tileRuns << " tile runs in "
+     << report.ms << " ms\n"
+     << report.hits << " hits, " << report.maps << " maps, "
+     << report.prefetches << " prefetched, " << report.evictions
+     << " evictions\n"
+     << "peak " << report.peakMapped << " of " << report.budget
+     << " bytes mapped";
+  return os;
+}
+
+struct TiledOptions {
+  uint64_t budget = 256ull << 20; // bytes of tiles mapped at once
+  uint32_t prefetch = 1;          // steps read ahead
+  std::string scratch = "/var/tmp";
+};
+
+class TiledGraph {
+public:
+  using Kernel = std::function<void(const TileContext &)>;
+
+  using Options = TiledOptions;
+
+  TiledGraph(const ImageData &extent, TileShape shape, Options options = {})
+      : shape_(shape), options_(std::move(options)) {
+    extent_[0] = extent.width;
+    extent_[1] = extent.height;
+    extent_[2] = std::max(extent.depth, 1u);
+    init();
+  }
+  // BufferData::size is a 32-bit byte count, so a buffer tops out just below
+  // 4 GiB (2^30 floats); larger data goes through the ImageData constructor
+  // as rows of a volume
+  TiledGraph(const BufferData &extent, uint32_t chunk, Options options = {})
+      : shape_{chunk, 1, 1}, options_(std::move(options)) {
+    extent_[0] = extent.size / sizeof(float);
+    extent_[1] = extent_[2] = 1;
+    init();
+  }
+  TiledGraph(const TiledGraph &) = delete;
+  TiledGraph &operator=(const TiledGraph &) = delete;
+  ~TiledGraph() {
+    for (auto &[key, tile] : mapped_)
+      munmap(tile.data, tileStride_);
+    for (auto &resource : resources_)
+      ::close(resource.fd);
+  }
+
+  // path empty: unlinked temporary file in Options::scratch; an existing
+  // file of the right size is used as is, so earlier results can be read
+  ResourceId addResource(std::string name, const std::string &path = {}) {
+    int fd;
+    if (path.empty()) {
+      std::string pattern = options_.scratch + "/tiled.XXXXXX";
+      fd = mkstemp(pattern.data());
+      if (fd >= 0)
+        unlink(pattern.c_str());
+    } else {
+      fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    }
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(),
+                              "tiled resource " + name);
+    // sparse, only written tiles take disk space; never shrinks a file
+    struct stat st;
+    off_t size = off_t(tileCount_ * tileStride_);
+    if (fstat(fd, &st) != 0 ||
+        (st.st_size < size && ftruncate(fd, size) != 0)) {
+      int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), "ftruncate");
+    }
+    resources_.push_back({std::move(name), fd});
+    return static_cast<ResourceId>(resources_.size() - 1);
+  }
+
+  PassId addPass(std::string name, std::vector<TiledRead> reads,
+                 std::vector<ResourceId> writes, Kernel kernel) {
+    PassId id = static_cast<PassId>(passes_.size());
+    for (const TiledRead &read : reads) {
+      resources_.at(read.resource); // bounds check
+      const Footprint &f = read.footprint;
+      if (f.x > shape_.width || f.y > shape_.height || f.z > shape_.depth)
+        throw std::invalid_argument("pass " + name +
+                                    " reads further than one tile");
+    }
+    for (ResourceId r : writes) {
+      if (resources_.at(r).writer != ~0u)
+        throw std::logic_error("resource " + resources_[r].name +
+                               " has two writers");
+      for (const TiledRead &read : reads)
+        if (read.resource == r)
+          throw std::logic_error("pass " + name + " reads and writes " +
+                                 resources_[r].name);
+      resources_[r].writer = id;
+    }
+    passes_.push_back({std::move(name), std::move(reads), std::move(writes),
+                       std::move(kernel)});
+    return id;
+  }
+
+  // raw float volume, x fastest and no header, into / out of the tiles
+  void importRaw(ResourceId id, const std::string &path) {
+    transferRaw(id, path, false);
+  }
+  void exportRaw(ResourceId id, const std::string &path) {
+    transferRaw(id, path, true);
+  }
+
+  // single element, for checks; maps the tile like any other access
+  float at(ResourceId id, uint32_t x, uint32_t y, uint32_t z) {
+    uint64_t tile = tileOf(x / shape_.width, y / shape_.height,
+                           z / shape_.depth);
+    const float *data = acquire(id, tile, false);
+    float value = data[(x % shape_.width) +
+                       shape_.width * ((y % shape_.height) +
+                                       shape_.height * (z % shape_.depth))];
+    release(id, tile);
+    return value;
+  }
+
+  TiledReport run() {
+    auto begin = std::chrono::steady_clock::now();
+    schedule();
+    report_.budget = options_.budget;
+    uint64_t steps = tileCount_ + maxLag_;
+    for (uint64_t step = 0; step < steps; ++step) {
+      for (PassId p : order_) {
+        if (step < lag_[p] || step - lag_[p] >= tileCount_)
+          continue;
+        runTile(p, step - lag_[p]);
+      }
+      for (uint32_t ahead = 1; ahead <= prefetch_; ++ahead)
+        prefetch(step, step + ahead);
+      ++report_.steps;
+    }
+    report_.ms = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - begin)
+                     .count();
+    TiledReport report = report_;
+    report_ = {};
+    report_.peakMapped = mappedBytes_;
+    return report;
+  }
+
+  uint64_t tileCount() const { return tileCount_; }
+  uint64_t tileBytes() const { return tileStride_; }
+
+private:
+  struct Resource {
+    std::string name;
+    int fd;
+    PassId writer = ~0u;
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<TiledRead> reads;
+    std::vector<ResourceId> writes;
+    Kernel kernel;
+  };
+
+  struct Mapped {
+    float *data;
+    uint32_t pins;
+    std::list<uint64_t>::iterator lru;
+  };
+
+  void init() {
+    if (shape_.width == 0 || shape_.height == 0 || shape_.depth == 0)
+      throw std::invalid_argument("empty tile shape");
+    if (extent_[0] == 0 || extent_[1] == 0)
+      throw std::invalid_argument("empty extent");
+    grid_[0] = (extent_[0] + shape_.width - 1) / shape_.width;
+    grid_[1] = (extent_[1] + shape_.height - 1) / shape_.height;
+    grid_[2] = (extent_[2] + shape_.depth - 1) / shape_.depth;
+    tileCount_ = uint64_t(grid_[0]) * grid_[1] * grid_[2];
+    uint64_t page = uint64_t(sysconf(_SC_PAGESIZE));
+    uint64_t bytes =
+        uint64_t(shape_.width) * shape_.height * shape_.depth * sizeof(float);
+    tileStride_ = (bytes + page - 1) / page * page;
+  }
+
+  uint64_t tileOf(uint64_t x, uint64_t y, uint64_t z) const {
+    return x + grid_[0] * (y + grid_[1] * z);
+  }
+  static uint64_t key(ResourceId id, uint64_t tile) {
+    return uint64_t(id) << 40 | tile;
+  }
+
+  // lag[p] = max over produced inputs of lag[writer] + the largest linear
+  // distance to a neighbour tile the footprint reaches
+  void schedule() {
+    std::vector<uint32_t> pending(passes_.size(), 0);
+    for (const Pass &pass : passes_)
+      for (const TiledRead &read : pass.reads)
+        if (resources_[read.resource].writer != ~0u)
+          ++pending[&pass - passes_.data()];
+    order_.clear();
+    for (PassId p = 0; p < passes_.size(); ++p)
+      if (pending[p] == 0)
+        order_.push_back(p);
+    for (std::size_t i = 0; i < order_.size(); ++i)
+      for (ResourceId r : passes_[order_[i]].writes)
+        for (PassId q = 0; q < passes_.size(); ++q)
+          for (const TiledRead &read : passes_[q].reads)
+            if (read.resource == r && --pending[q] == 0)
+              order_.push_back(q);
+    if (order_.size() != passes_.size())
+      throw std::logic_error("tiled graph has a cycle");
+
+    lag_.assign(passes_.size(), 0);
+    maxLag_ = 0;
+    uint64_t widest = 0, step = 0;
+    for (PassId p : order_) {
+      uint64_t tiles = passes_[p].writes.size();
+      for (const TiledRead &read : passes_[p].reads) {
+        const Footprint &f = read.footprint;
+        tiles += uint64_t(f.x ? 3 : 1) * (f.y ? 3 : 1) * (f.z ? 3 : 1);
+        PassId writer = resources_[read.resource].writer;
+        if (writer == ~0u)
+          continue;
+        uint64_t reach = (f.x ? 1 : 0) + (f.y ? grid_[0] : 0) +
+                         (f.z ? uint64_t(grid_[0]) * grid_[1] : 0);
+        lag_[p] = std::max(lag_[p], lag_[writer] + reach);
+      }
+      maxLag_ = std::max(maxLag_, lag_[p]);
+      widest = std::max(widest, tiles);
+      step += tiles;
+    }
+    // reading ahead only pays if the steps it covers fit next to the
+    // current one, otherwise it evicts what is about to be used
+    prefetch_ = options_.prefetch;
+    while (prefetch_ > 0 && (prefetch_ + 1) * step * tileStride_ >
+                                options_.budget)
+      --prefetch_;
+    if (widest * tileStride_ > options_.budget)
+      throw std::runtime_error(
+          "memory budget of " + std::to_string(options_.budget) +
+          " bytes is smaller than the " + std::to_string(widest * tileStride_) +
+          " bytes one pass needs for a tile");
+  }
+
+  // maps (or finds) a tile and pins it until release()
+  float *acquire(ResourceId id, uint64_t tile, bool prefetched) {
+    uint64_t k = key(id, tile);
+    if (auto it = mapped_.find(k); it != mapped_.end()) {
+      ++it->second.pins;
+      lru_.splice(lru_.end(), lru_, it->second.lru);
+      if (!prefetched)
+        ++report_.hits;
+      return it->second.data;
+    }
+    makeRoom();
+    void *address = mmap(nullptr, tileStride_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, resources_[id].fd,
+                         off_t(tile * tileStride_));
+    if (address == MAP_FAILED)
+      throw std::system_error(errno, std::generic_category(), "mmap tile");
+    if (prefetched) {
+      madvise(address, tileStride_, MADV_WILLNEED);
+      ++report_.prefetches;
+    } else {
+      ++report_.maps;
+    }
+    float *data = static_cast<float *>(address);
+    mapped_.emplace(k, Mapped{data, 1, lru_.insert(lru_.end(), k)});
+    mappedBytes_ += tileStride_;
+    report_.peakMapped = std::max(report_.peakMapped, mappedBytes_);
+    return data;
+  }
+
+  void release(ResourceId id, uint64_t tile) {
+    --mapped_.find(key(id, tile))->second.pins;
+  }
+
+  void makeRoom() {
+    auto it = lru_.begin();
+    while (mappedBytes_ + tileStride_ > options_.budget) {
+      while (it != lru_.end() && mapped_.find(*it)->second.pins != 0)
+        ++it;
+      if (it == lru_.end())
+        throw std::runtime_error("memory budget exhausted by pinned tiles");
+      auto victim = mapped_.find(*it);
+      munmap(victim->second.data, tileStride_);
+      mapped_.erase(victim);
+      it = lru_.erase(it);
+      mappedBytes_ -= tileStride_;
+      ++report_.evictions;
+    }
+  }
+
+  // calls f(tile) for the tiles of a footprint around tile t
+  template <typename F>
+  void forEachNeighbour(uint64_t t, const Footprint &f, F &&visit) const {
+    int64_t cx = t % grid_[0], cy = t / grid_[0] % grid_[1],
+            cz = t / grid_[0] / grid_[1];
+    int rx = f.x ? 1 : 0, ry = f.y ? 1 : 0, rz = f.z ? 1 : 0;
+    for (int dz = -rz; dz <= rz; ++dz)
+      for (int dy = -ry; dy <= ry; ++dy)
+        for (int dx = -rx; dx <= rx; ++dx) {
+          int64_t x = cx + dx, y = cy + dy, z = cz + dz;
+          if (x < 0 || y < 0 || z < 0 || x >= grid_[0] || y >= grid_[1] ||
+              z >= grid_[2])
+            continue;
+          visit(tileOf(x, y, z), (dx + 1) + 3 * ((dy + 1) + 3 * (dz + 1)));
+        }
+  }
+
+  void runTile(PassId p, uint64_t t) {
+    const Pass &pass = passes_[p];
+    uint32_t cx = t % grid_[0], cy = t / grid_[0] % grid_[1],
+             cz = t / grid_[0] / grid_[1];
+    TileRegion region{cx * shape_.width,
+                      cy * shape_.height,
+                      cz * shape_.depth,
+                      std::min(extent_[0], (cx + 1) * shape_.width),
+                      std::min(extent_[1], (cy + 1) * shape_.height),
+                      std::min(extent_[2], (cz + 1) * shape_.depth)};
+
+    inputs_.assign(pass.reads.size(), TileInput{});
+    outputs_.assign(pass.writes.size(), TileOutput{});
+    for (std::size_t i = 0; i < pass.reads.size(); ++i) {
+      TileInput &input = inputs_[i];
+      input.centre_ = region;
+      input.shape_ = shape_;
+      std::copy_n(extent_, 3, input.extent_);
+      forEachNeighbour(t, pass.reads[i].footprint,
+                       [&](uint64_t tile, int slot) {
+                         input.tiles_[slot] =
+                             acquire(pass.reads[i].resource, tile, false);
+                       });
+    }
+    for (std::size_t i = 0; i < pass.writes.size(); ++i) {
+      outputs_[i].data_ = acquire(pass.writes[i], t, false);
+      outputs_[i].region_ = region;
+      outputs_[i].shape_ = shape_;
+    }
+
+    pass.kernel(TileContext{region, shape_, inputs_, outputs_});
+    ++report_.tileRuns;
+
+    for (std::size_t i = 0; i < pass.reads.size(); ++i)
+      forEachNeighbour(t, pass.reads[i].footprint, [&](uint64_t tile, int) {
+        release(pass.reads[i].resource, tile);
+      });
+    for (ResourceId r : pass.writes)
+      release(r, t);
+  }
+
+  // maps the input tiles of step next that exist by the end of step done
+  void prefetch(uint64_t done, uint64_t next) {
+    for (PassId p : order_) {
+      if (next < lag_[p] || next - lag_[p] >= tileCount_)
+        continue;
+      uint64_t t = next - lag_[p];
+      for (const TiledRead &read : passes_[p].reads) {
+        PassId writer = resources_[read.resource].writer;
+        forEachNeighbour(t, read.footprint, [&](uint64_t tile, int) {
+          if (writer != ~0u &&
+              (done < lag_[writer] || tile > done - lag_[writer]))
+            return; // not written yet
+          // also refreshes mapped tiles, so what the next step needs is
+          // the most recently used and the last to be evicted
+          acquire(read.resource, tile, true);
+          release(read.resource, tile);
+        });
+      }
+    }
+  }
+
+  void transferRaw(ResourceId id, const std::string &path, bool out) {
+    int fd = out ? open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)
+                 : open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(), path);
+    std::vector<float> row(extent_[0]);
+    std::size_t rowBytes = row.size() * sizeof(float);
+    for (uint32_t z = 0; z < extent_[2]; ++z)
+      for (uint32_t y = 0; y < extent_[1]; ++y) {
+        off_t offset = off_t((uint64_t(z) * extent_[1] + y) * rowBytes);
+        if (!out && pread(fd, row.data(), rowBytes, offset) !=
+                        static_cast<ssize_t>(rowBytes)) {
+          ::close(fd);
+          throw std::runtime_error(path + ": short read");
+        }
+        std::size_t inTile = (y % shape_.height +
+                              std::size_t(shape_.height) * (z % shape_.depth)) *
+                             shape_.width;
+        for (uint32_t tx = 0; tx < grid_[0]; ++tx) {
+          uint64_t tile = tileOf(tx, y / shape_.height, z / shape_.depth);
+          float *data = acquire(id, tile, false);
+          uint32_t x0 = tx * shape_.width;
+          uint32_t n = std::min(shape_.width, extent_[0] - x0);
+          if (out)
+            std::copy_n(data + inTile, n, row.data() + x0);
+          else
+            std::copy_n(row.data() + x0, n, data + inTile);
+          release(id, tile);
+        }
+        if (out && pwrite(fd, row.data(), rowBytes, offset) !=
+                       static_cast<ssize_t>(rowBytes)) {
+          ::close(fd);
+          throw std::runtime_error(path + ": short write");
+        }
+      }
+    ::close(fd);
+  }
+
+  TileShape shape_;
+  Options options_;
+  uint32_t extent_[3] = {};
+  uint32_t grid_[3] = {};
+  uint64_t tileCount_ = 0;
+  uint64_t tileStride_ = 0;
+
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  std::vector<PassId> order_;
+  std::vector<uint64_t> lag_;
+  uint64_t maxLag_ = 0;
+  uint32_t prefetch_ = 0;
+
+  std::unordered_map<uint64_t, Mapped> mapped_;
+  std::list<uint64_t> lru_; // front: least recently used
+  uint64_t mappedBytes_ = 0;
+  std::vector<TileInput> inputs_;
+  std::vector<TileOutput> outputs_;
+  TiledReport report_;
+};
@@ -0,0 +1,377 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define GRAPH_TRACE_HAS_RDTSC 1
+#endif
+
+/**
+ pass tracing
+
+ 1. TRACE_ZONE(name, tag) times the enclosing scope, the tag is usually the
+    resource the pass works on; TRACE_FRAME(index) brackets one frame;
+ 2. every thread writes into its own ring buffer, single producer / single
+    consumer, no locks on the hot path; a full buffer drops events and
+    counts them;
+ 3. timestamps are rdtsc ticks on x86 (steady_clock elsewhere, or with
+    GRAPH_TRACE_STEADY_CLOCK), converted to ns when the trace is exported;
+ 4. Tracer::writeChromeTrace() writes trace event JSON (chrome://tracing,
+    perfetto), Tracer::printSummary() prints per frame critical path and
+    idle time.
+
+ without GRAPH_TRACE the macros expand to nothing and their arguments are
+ never evaluated.
+*/
+
+struct TraceEvent {
+  static constexpr std::size_t tagSize = 32;
+
+  const char *name; // string literal, outlives the trace
+  uint64_t begin;
+  uint64_t end;
+  uint64_t frame;
+  uint32_t depth; // nesting on the emitting thread, 0 = top level
+  char tag[tagSize];
+};
+
+class Tracer {
+public:
+  static constexpr uint64_t noFrame = ~uint64_t(0);
+
+  struct ThreadBuffer {
+    static constexpr std::size_t capacity = 1 << 14;
+
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[capacity]};
+    std::atomic<uint64_t> head{0}; // written by the owning thread
+    std::atomic<uint64_t> tail{0}; // written by the collector
+    std::atomic<uint64_t> dropped{0};
+    uint32_t tid = 0;
+    uint32_t depth = 0;
+
+    void push(const TraceEvent &event) {
+      uint64_t h = head.load(std::memory_order_relaxed);
+      if (h - tail.load(std::memory_order_acquire) >= capacity) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      events[h % capacity] = event;
+      head.store(h + 1, std::memory_order_release);
+    }
+  };
+
+  // an event after collection, times in ns since the tracer started
+  struct Zone {
+    std::string name;
+    std::string tag;
+    uint32_t tid;
+    uint32_t depth;
+    uint64_t frame;
+    double begin;
+    double end;
+
+    double duration() const { return end - begin; }
+  };
+
+  static Tracer &instance() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  static uint64_t now() {
+#if defined(GRAPH_TRACE_HAS_RDTSC) && !defined(GRAPH_TRACE_STEADY_CLOCK)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  ThreadBuffer &local() {
+    thread_local ThreadBuffer *buffer = registerThread();
+    return *buffer;
+  }
+
+  void setFrame(uint64_t frame) {
+    frame_.store(frame, std::memory_order_relaxed);
+  }
+  uint64_t frame() const { return frame_.load(std::memory_order_relaxed); }
+
+  // moves everything the threads wrote so far into the collected zones
+  const std::vector<Zone> &collect() {
+    std::lock_guard lock(mutex_);
+    double nsPerTick = calibrate();
+    for (auto &buffer : buffers_) {
+      uint64_t t = buffer->tail.load(std::memory_order_relaxed);
+      uint64_t h = buffer->head.load(std::memory_order_acquire);
+      for (; t != h; ++t) {
+        const auto &e = buffer->events[t % ThreadBuffer::capacity];
+        zones_.push_back({e.name,
+                          std::string(e.tag, strnlen(e.tag, sizeof(e.tag))),
+                          buffer->tid, e.depth, e.frame,
+                          (e.begin - origin_) * nsPerTick,
+                          (e.end - origin_) * nsPerTick});
+      }
+      buffer->tail.store(t, std::memory_order_release);
+    }
+    return zones_;
+  }
+
+  uint64_t dropped() {
+    std::lock_guard lock(mutex_);
+    uint64_t total = 0;
+    for (auto &buffer : buffers_)
+      total += buffer->dropped.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  void clear() {
+    collect();
+    std::lock_guard lock(mutex_);
+    zones_.clear();
+  }
+
+  bool writeChromeTrace(const std::string &path) {
+    const auto &zones = collect();
+    std::ofstream out(path);
+    if (!out)
+      return false;
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\": [";
+    for (std::size_t i = 0; i < zones.size(); ++i) {
+      const auto &z = zones[i];
+      out << (i ? "," : "") << "\n  {\"name\": ";
+      writeJsonString(out, z.name);
+      out << ", \"cat\": \"" << (z.frame == noFrame ? "other" : "pass")
+          << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << z.tid
+          << ", \"ts\": " << z.begin / 1000.0
+          << ", \"dur\": " << z.duration() / 1000.0 << ", \"args\": {";
+      out << "\"resource\": ";
+      writeJsonString(out, z.tag);
+      if (z.frame != noFrame)
+        out << ", \"frame\": " << z.frame;
+      out << "}}";
+    }
+    out << "\n], \"displayTimeUnit\": \"ns\"}\n";
+    return true;
+  }
+
+  // per frame: wall time, critical path, idle time of every thread and the
+  // time spent in each pass
+  void printSummary(std::ostream &os) {
+    const auto &zones = collect();
+    std::map<uint64_t, std::vector<const Zone *>> frames;
+    std::map<uint64_t, const Zone *> frameZones;
+    for (const auto &z : zones) {
+      if (z.frame == noFrame)
+        continue;
+      if (z.name == frameZoneName)
+        frameZones[z.frame] = &z;
+      else
+        frames[z.frame].push_back(&z);
+    }
+
+    auto ms = [](double ns) { return ns / 1e6; };
+    os << std::fixed << std::setprecision(3);
+    for (auto &[frame, list] : frames) {
+      double begin = list.front()->begin, end = list.front()->end;
+      if (auto it = frameZones.find(frame); it != frameZones.end()) {
+        begin = it->second->begin;
+        end = it->second->end;
+      } else {
+        for (const Zone *z : list) {
+          begin = std::min(begin, z->begin);
+          end = std::max(end, z->end);
+        }
+      }
+
+      std::vector<const Zone *> top;
+      for (const Zone *z : list)
+        if (z->depth == 0)
+          top.push_back(z);
+
+      // critical path: walk back from the zone that finished last, each
+      // step takes the zone that finished latest before the current started
+      std::vector<const Zone *> path;
+      double pathNs = 0;
+      const Zone *current = nullptr;
+      for (const Zone *z : top)
+        if (!current || z->end > current->end)
+          current = z;
+      while (current) {
+        path.push_back(current);
+        pathNs += current->duration();
+        const Zone *previous = nullptr;
+        for (const Zone *z : top)
+          if (z->end <= current->begin &&
+              (!previous || z->end > previous->end))
+            previous = z;
+        current = previous;
+      }
+
+      os << "frame " << frame << ": " << ms(end - begin)
+         << " ms, critical path " << ms(pathNs) << " ms (";
+      for (auto it = path.rbegin(); it != path.rend(); ++it)
+        os << (it == path.rbegin() ? "" : " > ") << (*it)->name;
+      os << ")\n";
+
+      // idle = frame time not covered by top level zones of that thread
+      std::map<uint32_t, double> busy;
+      for (const Zone *z : top)
+        busy[z->tid] += std::min(z->end, end) - std::max(z->begin, begin);
+      for (auto &[tid, ns] : busy)
+        os << "  thread " << tid << ": busy " << ms(ns) << " ms, idle "
+           << ms(std::max(0.0, end - begin - ns)) << " ms\n";
+
+      std::map<std::string, std::pair<int, double>> passes;
+      for (const Zone *z : top) {
+        passes[z->name].first++;
+        passes[z->name].second += z->duration();
+      }
+      for (auto &[name, stat] : passes)
+        os << "  " << std::left << std::setw(28) << name << std::right
+           << " x" << stat.first << "  " << ms(stat.second) << " ms\n";
+    }
+    if (uint64_t lost = dropped())
+      os << "(" << lost << " trace events dropped, buffers were full)\n";
+  }
+
+  static constexpr const char *frameZoneName = "frame";
+
+private:
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+  std::vector<Zone> zones_;
+  std::atomic<uint64_t> frame_{noFrame};
+  uint64_t origin_ = now();
+  std::chrono::steady_clock::time_point originTime_ =
+      std::chrono::steady_clock::now();
+
+  Tracer() = default;
+
+  // quoted and escaped, zone names and tags may hold any resource name
+  static void writeJsonString(std::ostream &out, std::string_view text) {
+    out << '"';
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        out << '\\' << c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x",
+                      static_cast<unsigned>(c));
+        out << escaped;
+      } else {
+        out << c;
+      }
+    }
+    out << '"';
+  }
+
+  ThreadBuffer *registerThread() {
+    std::lock_guard lock(mutex_);
+    buffers_.push_back(std::make_unique<ThreadBuffer>());
+    buffers_.back()->tid = static_cast<uint32_t>(buffers_.size() - 1);
+    return buffers_.back().get();
+  }
+
+  // ns per timestamp tick, measured against steady_clock since startup
+  double calibrate() const {
+#if defined(GRAPH_TRACE_HAS_RDTSC) && !defined(GRAPH_TRACE_STEADY_CLOCK)
+    using namespace std::chrono;
+    auto elapsed = [&] {
+      return duration<double, std::nano>(steady_clock::now() - originTime_)
+          .count();
+    };
+    while (elapsed() < 5e6) // too short to calibrate against
+      ;
+    uint64_t ticks = now() - origin_;
+    return elapsed() / static_cast<double>(ticks);
+#else
+    return 1.0;
+#endif
+  }
+};
+
+// records the enclosing scope as one complete event
+class TraceZone {
+  const char *name_;
+  uint64_t begin_;
+  uint64_t frame_;
+  uint32_t depth_;
+  char tag_[TraceEvent::tagSize];
+
+public:
+  TraceZone(const char *name, std::string_view tag)
+      : name_(name), frame_(Tracer::instance().frame()) {
+    std::size_t n = std::min(tag.size(), sizeof(tag_) - 1);
+    std::memcpy(tag_, tag.data(), n);
+    tag_[n] = '\0';
+    auto &buffer = Tracer::instance().local();
+    depth_ = buffer.depth++;
+    begin_ = Tracer::now();
+  }
+  ~TraceZone() {
+    uint64_t end = Tracer::now();
+    auto &buffer = Tracer::instance().local();
+    --buffer.depth;
+    TraceEvent event{name_, begin_, end, frame_, depth_, {}};
+    std::memcpy(event.tag, tag_, sizeof(tag_));
+    buffer.push(event);
+  }
+  TraceZone(const TraceZone &) = delete;
+  TraceZone &operator=(const TraceZone &) = delete;
+};
+
+// marks the current frame for zones opened on any thread, the frame itself
+// is recorded so the summary knows its wall time; it does not count as a
+// nesting level for the zones inside
+class TraceFrame {
+  uint64_t frame_;
+  uint64_t begin_;
+
+public:
+  explicit TraceFrame(uint64_t frame) : frame_(frame) {
+    Tracer::instance().setFrame(frame);
+    begin_ = Tracer::now();
+  }
+  ~TraceFrame() {
+    uint64_t end = Tracer::now();
+    auto &tracer = Tracer::instance();
+    tracer.local().push({Tracer::frameZoneName, begin_, end, frame_, 0, {}});
+    tracer.setFrame(Tracer::noFrame);
+  }
+  TraceFrame(const TraceFrame &) = delete;
+  TraceFrame &operator=(const TraceFrame &) = delete;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#if defined(GRAPH_TRACE)
+#define TRACE_ZONE(name, tag)                                                  \
+  TraceZone TRACE_CONCAT(traceZone, __LINE__)((name), (tag))
+#define TRACE_FRAME(index)                                                     \
+  TraceFrame TRACE_CONCAT(traceFrame, __LINE__)(index)
+#else
+#define TRACE_ZONE(name, tag) ((void)0)
+#define TRACE_FRAME(index) ((void)0)
+#endif
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+/**
+ LZ4 style block compression, no dependencies
+
+ 1. lzCompress() is a greedy LZ77 with a single probe hash table over 4 byte
+    sequences and 16 bit offsets; every sequence is a token byte (literal
+    length and match length - 4 as nibbles, 15 means more length bytes
+    follow), the literals, a little endian offset and the extra length
+    bytes; the block ends with a literal only sequence;
+ 2. lzDecompress() checks every length and offset against both buffers and
+    throws on a corrupt block instead of reading or writing out of bounds;
+ 3. floatShuffle() prepares float or int32 arrays whose neighbours are
+    close (positions, velocities, densities): each word is replaced by its
+    difference to the previous one and the bytes are split into four planes,
+    so the nearly constant high bytes form long runs for the LZ stage;
+    floatUnshuffle() undoes it.
+
+ throughput is in the hundreds of MB/s per core, ratios are what LZ4 gets.
+*/
+
+namespace compress_detail {
+inline constexpr std::size_t minMatch = 4;
+inline constexpr std::size_t hashBits = 14;
+inline constexpr std::size_t maxOffset = 65535;
+// matches must end this far from the end so the decoder's tail is literals
+inline constexpr std::size_t lastLiterals = 5;
+
+inline uint32_t read32(const std::byte *p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+inline uint32_t hash4(uint32_t v) {
+  return (v * 2654435761u) >> (32 - hashBits);
+}
+
+inline void writeLength(std::vector<std::byte> &out, std::size_t length) {
+  while (length >= 255) {
+    out.push_back(std::byte{255});
+    length -= 255;
+  }
+  out.push_back(static_cast<std::byte>(length));
+}
+
+inline void writeSequence(std::vector<std::byte> &out,
+                          const std::byte *literals, std::size_t literalCount,
+                          std::size_t offset, std::size_t matchLength) {
+  std::size_t match = matchLength ? matchLength - minMatch : 0;
+  out.push_back(static_cast<std::byte>(
+      (std::min<std::size_t>(literalCount, 15) << 4) |
+      std::min<std::size_t>(match, 15)));
+  if (literalCount >= 15)
+    writeLength(out, literalCount - 15);
+  out.insert(out.end(), literals, literals + literalCount);
+  if (matchLength == 0)
+    return;
+  out.push_back(static_cast<std::byte>(offset & 0xff));
+  out.push_back(static_cast<std::byte>(offset >> 8));
+  if (match >= 15)
+    writeLength(out, match - 15);
+}
+} // namespace compress_detail
+
+// upper bound of lzCompress() output for n input bytes
+inline std::size_t lzBound(std::size_t n) { return n + n / 255 + 16; }
+
+inline void lzCompress(std::span<const std::byte> in,
+                       std::vector<std::byte> &out) {
+  using namespace compress_detail;
+  out.clear();
+  out.reserve(lzBound(in.size()));
+  const std::byte *base = in.data();
+  std::size_t n = in.size();
+  std::size_t anchor = 0;
+  if (n > minMatch + lastLiterals) {
+    std::vector<uint32_t> table(std::size_t(1) << hashBits, 0);
+    std::size_t limit = n - lastLiterals - minMatch;
+    std::size_t i = 1; // position 0 is the table's empty value
+    std::size_t misses = 0;
+    while (i <= limit) {
+      uint32_t v = read32(base + i);
+      uint32_t &slot = table[hash4(v)];
+      std::size_t candidate = slot;
+      slot = static_cast<uint32_t>(i);
+      if (candidate == 0 || i - candidate > maxOffset ||
+          read32(base + candidate) != v) {
+        i += 1 + (misses++ >> 6); // skip faster through incompressible data
+        continue;
+      }
+      misses = 0;
+      std::size_t length = minMatch;
+      std::size_t end = n - lastLiterals;
+      while (i + length < end && base[candidate + length] == base[i + length])
+        ++length;
+      // extend backwards over literals that match as well
+      while (i > anchor && candidate > 0 &&
+             base[i - 1] == base[candidate - 1]) {
+        --i;
+        --candidate;
+        ++length;
+      }
+      writeSequence(out, base + anchor, i - anchor, i - candidate, length);
+      i += length;
+      anchor = i;
+      if (i - 2 <= limit)
+        table[hash4(read32(base + i - 2))] = static_cast<uint32_t>(i - 2);
+    }
+  }
+  writeSequence(out, base + anchor, n - anchor, 0, 0);
+}
+
+// out must be sized to the exact uncompressed size
+inline void lzDecompress(std::span<const std::byte> in,
+                         std::span<std::byte> out) {
+  using namespace compress_detail;
+  auto fail = [] { throw std::runtime_error("corrupt lz block"); };
+  std::size_t ip = 0, op = 0;
+  auto readLength = [&](std::size_t length) {
+    if (length != 15)
+      return length;
+    std::byte b;
+    do {
+      if (ip >= in.size())
+        fail();
+      b = in[ip++];
+      length += std::to_integer<std::size_t>(b);
+    } while (b == std::byte{255});
+    return length;
+  };
+  while (true) {
+    if (ip >= in.size())
+      fail();
+    auto token = std::to_integer<std::size_t>(in[ip++]);
+    std::size_t literals = readLength(token >> 4);
+    if (literals > in.size() - ip || literals > out.size() - op)
+      fail();
+    std::memcpy(out.data() + op, in.data() + ip, literals);
+    ip += literals;
+    op += literals;
+    if (ip == in.size())
+      break; // final literal only sequence
+    if (in.size() - ip < 2)
+      fail();
+    std::size_t offset = std::to_integer<std::size_t>(in[ip]) |
+                         std::to_integer<std::size_t>(in[ip + 1]) << 8;
+    ip += 2;
+    std::size_t length = readLength(token & 15) + minMatch;
+    if (offset == 0 || offset > op || length > out.size() - op)
+      fail();
+    // overlapping copies repeat the last offset bytes, copy forwards
+    std::byte *d = out.data() + op;
+    const std::byte *s = d - offset;
+    if (offset >= length)
+      std::memcpy(d, s, length);
+    else
+      for (std::size_t k = 0; k < length; ++k)
+        d[k] = s[k];
+    op += length;
+  }
+  if (op != out.size())
+    fail();
+}
+
+inline void floatShuffle(std::span<const std::byte> in,
+                         std::span<std::byte> out) {
+  std::size_t words = in.size() / 4;
+  uint32_t previous = 0;
+  for (std::size_t i = 0; i < words; ++i) {
+    uint32_t v = compress_detail::read32(in.data() + 4 * i);
+    uint32_t delta = v - previous;
+    previous = v;
+    for (std::size_t b = 0; b < 4; ++b)
+      out[b * words + i] = static_cast<std::byte>(delta >> (8 * b));
+  }
+  std::memcpy(out.data() + 4 * words, in.data() + 4 * words, in.size() % 4);
+}
+
+inline void floatUnshuffle(std::span<const std::byte> in,
+                           std::span<std::byte> out) {
+  std::size_t words = in.size() / 4;
+  uint32_t previous = 0;
+  for (std::size_t i = 0; i < words; ++i) {
+    uint32_t delta = 0;
+    for (std::size_t b = 0; b < 4; ++b)
+      delta |= std::to_integer<uint32_t>(in[b * words + i]) << (8 * b);
+    previous += delta;
+    std::memcpy(out.data() + 4 * i, &previous, 4);
+  }
+  std::memcpy(out.data() + 4 * words, in.data() + 4 * words, in.size() % 4);
+}
@@ -0,0 +1,472 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "hash.hpp"
+#include "optional.hpp"
+
+/**
+ open addressing hash table, swiss table flavoured
+
+ 1. one control byte per slot: empty, deleted, or the low 7 bits of the hash;
+ 2. slots are probed in groups of 8, a group of control bytes is matched
+    against the 7 bit tag with one 64 bit word (SWAR), only tag hits compare
+    keys;
+ 3. groups are visited in triangular order, which covers every group of a
+    power of two table;
+ 4. the table grows at 7/8 load, elements are relocated into the new slots;
+ 5. FlatHashMap stores std::pair<const K, V> like std::unordered_map, a key
+    cannot be changed in place; relocation copies keys that are not
+    trivially relocatable (std::string), reserve() up front avoids that.
+
+ iterators and references are invalidated by any insertion that grows.
+*/
+
+namespace flat_detail {
+enum Ctrl : uint8_t { kEmpty = 0x80, kDeleted = 0xfe };
+
+inline constexpr std::size_t kGroupWidth = 8;
+inline constexpr uint64_t kLsbs = 0x0101010101010101ull;
+inline constexpr uint64_t kMsbs = 0x8080808080808080ull;
+
+// bitmask with the high bit of every matching byte set
+struct Group {
+  uint64_t ctrl;
+
+  // byte i of the word is always slot i of the group
+  explicit Group(const uint8_t *p) {
+    std::memcpy(&ctrl, p, sizeof(ctrl));
+    if constexpr (std::endian::native == std::endian::big)
+      ctrl = std::byteswap(ctrl);
+  }
+
+  // may report a false positive next to a real hit, keys are compared anyway
+  uint64_t match(uint8_t tag) const {
+    uint64_t x = ctrl ^ (kLsbs * tag);
+    return (x - kLsbs) & ~x & kMsbs;
+  }
+  uint64_t matchEmpty() const { return ctrl & (~ctrl << 6) & kMsbs; }
+  uint64_t matchEmptyOrDeleted() const { return ctrl & (~ctrl << 7) & kMsbs; }
+};
+
+inline std::size_t lowestByte(uint64_t mask) {
+  return static_cast<std::size_t>(std::countr_zero(mask)) >> 3;
+}
+inline uint64_t clearLowest(uint64_t mask) { return mask & (mask - 1); }
+
+template <typename Slot> struct MapKey {
+  template <typename S> static const auto &get(const S &slot) {
+    return slot.first;
+  }
+};
+struct SetKey {
+  template <typename S> static const S &get(const S &slot) { return slot; }
+};
+
+// shared by FlatHashMap and FlatHashSet, KeyOf extracts the key of a slot
+template <typename Slot, typename KeyOf, typename HashFn, typename KeyEq,
+          typename Alloc>
+class FlatTable {
+  using SlotAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+  using ByteAlloc =
+      typename std::allocator_traits<Alloc>::template rebind_alloc<uint8_t>;
+  using SlotTraits = std::allocator_traits<SlotAlloc>;
+
+  uint8_t *ctrl_ = nullptr;
+  Slot *slots_ = nullptr;
+  std::size_t capacity_ = 0; // 0 or a power of two >= kGroupWidth
+  std::size_t size_ = 0;
+  std::size_t growthLeft_ = 0;
+  [[no_unique_address]] HashFn hash_;
+  [[no_unique_address]] KeyEq eq_;
+  [[no_unique_address]] SlotAlloc alloc_;
+
+  static std::size_t maxLoad(std::size_t capacity) {
+    return capacity - capacity / 8;
+  }
+
+  static std::size_t h1(std::size_t hash) { return hash >> 7; }
+  static uint8_t h2(std::size_t hash) { return hash & 0x7f; }
+
+  std::size_t groupMask() const { return capacity_ / kGroupWidth - 1; }
+
+  void allocate(std::size_t capacity) {
+    ByteAlloc bytes(alloc_);
+    ctrl_ = std::allocator_traits<ByteAlloc>::allocate(bytes, capacity);
+    std::memset(ctrl_, kEmpty, capacity);
+    slots_ = SlotTraits::allocate(alloc_, capacity);
+    capacity_ = capacity;
+    growthLeft_ = maxLoad(capacity);
+  }
+
+  void deallocate() {
+    if (!ctrl_)
+      return;
+    ByteAlloc bytes(alloc_);
+    std::allocator_traits<ByteAlloc>::deallocate(bytes, ctrl_, capacity_);
+    SlotTraits::deallocate(alloc_, slots_, capacity_);
+    ctrl_ = nullptr;
+    slots_ = nullptr;
+    capacity_ = size_ = growthLeft_ = 0;
+  }
+
+  void destroyAll() {
+    for (std::size_t i = 0; i < capacity_; ++i)
+      if (isFull(ctrl_[i]))
+        SlotTraits::destroy(alloc_, slots_ + i);
+  }
+
+  static bool isFull(uint8_t ctrl) { return (ctrl & 0x80) == 0; }
+
+  // first empty or deleted slot on the probe sequence of hash
+  std::size_t findFree(std::size_t hash) const {
+    std::size_t group = h1(hash) & groupMask();
+    for (std::size_t step = 1;; ++step) {
+      Group g(ctrl_ + group * kGroupWidth);
+      if (uint64_t mask = g.matchEmptyOrDeleted())
+        return group * kGroupWidth + lowestByte(mask);
+      group = (group + step) & groupMask();
+    }
+  }
+
+  void rehash(std::size_t capacity) {
+    uint8_t *oldCtrl = ctrl_;
+    Slot *oldSlots = slots_;
+    std::size_t oldCapacity = capacity_;
+    std::size_t size = size_;
+    allocate(capacity);
+    for (std::size_t i = 0; i < oldCapacity; ++i) {
+      if (!isFull(oldCtrl[i]))
+        continue;
+      std::size_t hash = hash_(KeyOf::get(oldSlots[i]));
+      std::size_t pos = findFree(hash);
+      ctrl_[pos] = h2(hash);
+      relocate(oldSlots + i, 1, slots_ + pos);
+    }
+    growthLeft_ -= size;
+    if (oldCtrl) {
+      ByteAlloc bytes(alloc_);
+      std::allocator_traits<ByteAlloc>::deallocate(bytes, oldCtrl,
+                                                   oldCapacity);
+      SlotTraits::deallocate(alloc_, oldSlots, oldCapacity);
+    }
+  }
+
+  void growIfNeeded() {
+    if (growthLeft_ > 0)
+      return;
+    // plenty of tombstones: clean up in place instead of doubling
+    if (capacity_ != 0 && size_ <= maxLoad(capacity_) / 2)
+      rehash(capacity_);
+    else
+      rehash(capacity_ == 0 ? kGroupWidth : capacity_ * 2);
+  }
+
+public:
+  using key_type = std::remove_cvref_t<decltype(KeyOf::get(
+      std::declval<const Slot &>()))>;
+  using value_type = Slot;
+  using size_type = std::size_t;
+  using allocator_type = Alloc;
+
+  template <bool Const> class Iterator {
+    friend class FlatTable;
+    template <bool> friend class Iterator;
+    using Table = std::conditional_t<Const, const FlatTable, FlatTable>;
+    Table *table_ = nullptr;
+    std::size_t index_ = 0;
+
+    Iterator(Table *table, std::size_t index) : table_(table), index_(index) {
+      skipEmpty();
+    }
+    void skipEmpty() {
+      while (index_ < table_->capacity_ && !isFull(table_->ctrl_[index_]))
+        ++index_;
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Slot;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<Const, const Slot &, Slot &>;
+    using pointer = std::conditional_t<Const, const Slot *, Slot *>;
+
+    Iterator() = default;
+    operator Iterator<true>() const { return {table_, index_}; }
+
+    reference operator*() const { return table_->slots_[index_]; }
+    pointer operator->() const { return table_->slots_ + index_; }
+    Iterator &operator++() {
+      ++index_;
+      skipEmpty();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator it = *this;
+      ++*this;
+      return it;
+    }
+    bool operator==(const Iterator &other) const {
+      return index_ == other.index_;
+    }
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  FlatTable() = default;
+  explicit FlatTable(const Alloc &alloc) : alloc_(alloc) {}
+
+  FlatTable(const FlatTable &other)
+      : hash_(other.hash_), eq_(other.eq_),
+        alloc_(SlotTraits::select_on_container_copy_construction(
+            other.alloc_)) {
+    reserve(other.size_);
+    for (const auto &slot : other)
+      insertUnique(slot);
+  }
+  FlatTable(FlatTable &&other) noexcept
+      : ctrl_(std::exchange(other.ctrl_, nullptr)),
+        slots_(std::exchange(other.slots_, nullptr)),
+        capacity_(std::exchange(other.capacity_, 0)),
+        size_(std::exchange(other.size_, 0)),
+        growthLeft_(std::exchange(other.growthLeft_, 0)),
+        hash_(std::move(other.hash_)), eq_(std::move(other.eq_)),
+        alloc_(std::move(other.alloc_)) {}
+
+  FlatTable &operator=(const FlatTable &other) {
+    if (this != &other) {
+      clear();
+      reserve(other.size_);
+      for (const auto &slot : other)
+        insertUnique(slot);
+    }
+    return *this;
+  }
+  FlatTable &operator=(FlatTable &&other) noexcept(
+      SlotTraits::propagate_on_container_move_assignment::value ||
+      SlotTraits::is_always_equal::value) {
+    if (this == &other)
+      return *this;
+    destroyAll();
+    deallocate();
+    if constexpr (SlotTraits::propagate_on_container_move_assignment::value) {
+      alloc_ = std::move(other.alloc_);
+    } else if (alloc_ != other.alloc_) {
+      // memory of other belongs to another resource, move element-wise
+      reserve(other.size_);
+      for (auto &slot : other)
+        insertUnique(std::move(slot));
+      other.clear();
+      return *this;
+    }
+    ctrl_ = std::exchange(other.ctrl_, nullptr);
+    slots_ = std::exchange(other.slots_, nullptr);
+    capacity_ = std::exchange(other.capacity_, 0);
+    size_ = std::exchange(other.size_, 0);
+    growthLeft_ = std::exchange(other.growthLeft_, 0);
+    return *this;
+  }
+
+  ~FlatTable() {
+    destroyAll();
+    deallocate();
+  }
+
+  allocator_type get_allocator() const { return allocator_type(alloc_); }
+
+  iterator begin() { return {this, 0}; }
+  iterator end() { return {this, capacity_}; }
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, capacity_}; }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  std::size_t capacity() const { return capacity_; }
+
+  void reserve(std::size_t count) {
+    std::size_t capacity = kGroupWidth;
+    while (maxLoad(capacity) < count)
+      capacity *= 2;
+    if (capacity > capacity_)
+      rehash(capacity);
+  }
+
+  void clear() {
+    destroyAll();
+    if (ctrl_)
+      std::memset(ctrl_, kEmpty, capacity_);
+    size_ = 0;
+    growthLeft_ = maxLoad(capacity_);
+  }
+
+  template <typename K> std::size_t findIndex(const K &key) const {
+    if (size_ == 0)
+      return capacity_;
+    std::size_t hash = hash_(key);
+    uint8_t tag = h2(hash);
+    std::size_t group = h1(hash) & groupMask();
+    for (std::size_t step = 1;; ++step) {
+      Group g(ctrl_ + group * kGroupWidth);
+      for (uint64_t mask = g.match(tag); mask; mask = clearLowest(mask)) {
+        std::size_t index = group * kGroupWidth + lowestByte(mask);
+        if (ctrl_[index] == tag && eq_(KeyOf::get(slots_[index]), key))
+          return index;
+      }
+      if (g.matchEmpty())
+        return capacity_;
+      group = (group + step) & groupMask();
+    }
+  }
+
+  template <typename K> iterator find(const K &key) {
+    return {this, findIndex(key)};
+  }
+  template <typename K> const_iterator find(const K &key) const {
+    return {this, findIndex(key)};
+  }
+  template <typename K> bool contains(const K &key) const {
+    return findIndex(key) != capacity_;
+  }
+  template <typename K> std::size_t count(const K &key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  // finds key, or constructs a slot from args when it is missing
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> emplaceKey(const K &key, Args &&...args) {
+    std::size_t index = findIndex(key);
+    if (index != capacity_)
+      return {iterator(this, index), false};
+    growIfNeeded();
+    std::size_t hash = hash_(key);
+    index = findFree(hash);
+    SlotTraits::construct(alloc_, slots_ + index, std::forward<Args>(args)...);
+    if (ctrl_[index] == kEmpty)
+      --growthLeft_;
+    ctrl_[index] = h2(hash);
+    ++size_;
+    return {iterator(this, index), true};
+  }
+
+  std::pair<iterator, bool> insertUnique(const Slot &slot) {
+    return emplaceKey(KeyOf::get(slot), slot);
+  }
+  std::pair<iterator, bool> insertUnique(Slot &&slot) {
+    const auto &key = KeyOf::get(slot);
+    return emplaceKey(key, std::move(slot));
+  }
+
+  void erase(iterator it) {
+    SlotTraits::destroy(alloc_, slots_ + it.index_);
+    // a slot can go back to empty when its group never filled up, probes
+    // for other keys could not have passed through it
+    Group g(ctrl_ + (it.index_ & ~(kGroupWidth - 1)));
+    if (g.matchEmpty()) {
+      ctrl_[it.index_] = kEmpty;
+      ++growthLeft_;
+    } else {
+      ctrl_[it.index_] = kDeleted;
+    }
+    --size_;
+  }
+
+  template <typename K> std::size_t eraseKey(const K &key) {
+    std::size_t index = findIndex(key);
+    if (index == capacity_)
+      return 0;
+    erase(iterator(this, index));
+    return 1;
+  }
+};
+} // namespace flat_detail
+
+template <typename K, typename V, typename HashFn = Hash,
+          typename KeyEq = std::equal_to<>,
+          typename Alloc = std::allocator<std::pair<const K, V>>>
+class FlatHashMap
+    : public flat_detail::FlatTable<std::pair<const K, V>,
+                                    flat_detail::MapKey<std::pair<const K, V>>,
+                                    HashFn, KeyEq, Alloc> {
+  using Base =
+      flat_detail::FlatTable<std::pair<const K, V>,
+                             flat_detail::MapKey<std::pair<const K, V>>,
+                             HashFn, KeyEq, Alloc>;
+
+public:
+  using mapped_type = V;
+  using typename Base::iterator;
+  using typename Base::value_type;
+  using Base::Base;
+
+  template <typename Key, typename... Args>
+  std::pair<iterator, bool> try_emplace(Key &&key, Args &&...args) {
+    return this->emplaceKey(key, std::piecewise_construct,
+                            std::forward_as_tuple(std::forward<Key>(key)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  std::pair<iterator, bool> insert(const value_type &value) {
+    return this->insertUnique(value);
+  }
+  std::pair<iterator, bool> insert(value_type &&value) {
+    return this->insertUnique(std::move(value));
+  }
+
+  template <typename Key> V &operator[](Key &&key) {
+    return try_emplace(std::forward<Key>(key)).first->second;
+  }
+
+  template <typename Key> V &at(const Key &key) {
+    auto it = this->find(key);
+    if (it == this->end())
+      throw std::out_of_range("FlatHashMap::at");
+    return it->second;
+  }
+
+  using Base::erase;
+  template <typename Key>
+    requires(!std::is_convertible_v<const Key &, iterator>)
+  std::size_t erase(const Key &key) {
+    return this->eraseKey(key);
+  }
+};
+
+template <typename K, typename HashFn = Hash, typename KeyEq = std::equal_to<>,
+          typename Alloc = std::allocator<K>>
+class FlatHashSet
+    : public flat_detail::FlatTable<K, flat_detail::SetKey, HashFn, KeyEq,
+                                    Alloc> {
+  using Base =
+      flat_detail::FlatTable<K, flat_detail::SetKey, HashFn, KeyEq, Alloc>;
+
+public:
+  using typename Base::iterator;
+  using Base::Base;
+
+  template <typename... Args> std::pair<iterator, bool> emplace(Args &&...args) {
+    K key(std::forward<Args>(args)...);
+    return this->insertUnique(std::move(key));
+  }
+  std::pair<iterator, bool> insert(const K &key) {
+    return this->insertUnique(key);
+  }
+  std::pair<iterator, bool> insert(K &&key) {
+    return this->insertUnique(std::move(key));
+  }
+
+  using Base::erase;
+  template <typename Key>
+    requires(!std::is_convertible_v<const Key &, iterator>)
+  std::size_t erase(const Key &key) {
+    return this->eraseKey(key);
+  }
+};
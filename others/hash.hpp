@@ -0,0 +1,228 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/**
+ concept driven hashing
+
+ 1. a type describes its hashable fields once, hashFields() is found by ADL:
+      auto hashFields(const ImageData &d) { return std::tie(d.width, ...); }
+ 2. hashValue() folds the fields with a wyhash style 64 bit mixer; padding
+    free types (unique object representation) that declare no hashFields()
+    are hashed as one block of bytes;
+ 3. strings and contiguous ranges of plain bytes go through hashBytes(), which
+    runs three independent multiply lanes over long keys;
+ 4. Hash is a transparent functor, std::string keys can be looked up with a
+    std::string_view or a const char *.
+*/
+
+namespace hash_detail {
+inline constexpr uint64_t secret[4] = {
+    0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull,
+    0x589965cc75374cc3ull};
+
+// 64 x 64 -> 128 multiply, folded back to 64 bits
+inline uint64_t mum(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = static_cast<__uint128_t>(a) * b;
+  return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  uint64_t hi;
+  uint64_t lo = _umul128(a, b, &hi);
+  return lo ^ hi;
+#else
+  uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a),
+           lb = static_cast<uint32_t>(b);
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  return lo ^ hi;
+#endif
+}
+
+inline uint64_t read8(const uint8_t *p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+inline uint64_t read4(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+// 1..3 bytes, reads first, middle and last byte
+inline uint64_t read3(const uint8_t *p, std::size_t k) {
+  return (static_cast<uint64_t>(p[0]) << 16) |
+         (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+}
+} // namespace hash_detail
+
+inline uint64_t hashBytes(const void *key, std::size_t len, uint64_t seed = 0) {
+  using namespace hash_detail;
+  const uint8_t *p = static_cast<const uint8_t *>(key);
+  seed ^= mum(seed ^ secret[0], secret[1]);
+  uint64_t a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+      b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = read3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    std::size_t i = len;
+    if (i > 48) {
+      // three independent lanes keep the multipliers busy on long keys
+      uint64_t lane1 = seed, lane2 = seed;
+      do {
+        seed = mum(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+        lane1 = mum(read8(p + 16) ^ secret[2], read8(p + 24) ^ lane1);
+        lane2 = mum(read8(p + 32) ^ secret[3], read8(p + 40) ^ lane2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (i > 16) {
+      seed = mum(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read8(p + i - 16);
+    b = read8(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  uint64_t r = mum(a, b);
+  return mum(r ^ secret[0] ^ len, r ^ secret[1]);
+}
+
+// mixes one 64 bit word into a running hash
+inline uint64_t hashCombine(uint64_t seed, uint64_t value) {
+  using namespace hash_detail;
+  return mum(seed ^ value ^ secret[0], value ^ secret[2]);
+}
+
+// field description found by ADL, returns a tuple (usually std::tie)
+template <typename T>
+concept HasHashFields = requires(const T &value) {
+  { hashFields(value) };
+};
+
+// types whose bytes are their identity: integers, enums, pointers and
+// padding free aggregates of those
+template <typename T>
+concept ByteHashable = std::has_unique_object_representations_v<T> &&
+                       std::is_trivially_copyable_v<T>;
+
+template <typename T>
+concept StringLike = std::convertible_to<const T &, std::string_view>;
+
+template <typename T> struct IsTupleLike : std::false_type {};
+template <typename... Ts>
+struct IsTupleLike<std::tuple<Ts...>> : std::true_type {};
+template <typename A, typename B>
+struct IsTupleLike<std::pair<A, B>> : std::true_type {};
+
+inline uint64_t hashValue(std::string_view value, uint64_t seed = 0) {
+  return hashBytes(value.data(), value.size(), seed);
+}
+
+template <typename T>
+  requires(!StringLike<T>)
+uint64_t hashValue(const T &value, uint64_t seed = 0);
+
+namespace hash_detail {
+template <typename Tuple>
+uint64_t hashTuple(const Tuple &fields, uint64_t seed) {
+  return std::apply(
+      [seed](const auto &...field) {
+        uint64_t h = seed;
+        ((h = hashCombine(h, hashValue(field, h))), ...);
+        return h;
+      },
+      fields);
+}
+} // namespace hash_detail
+
+template <typename T>
+concept FastHashable = requires(const T &value) {
+  { hashValue(value) } -> std::same_as<uint64_t>;
+};
+
+template <typename T>
+  requires(!StringLike<T>)
+uint64_t hashValue(const T &value, uint64_t seed) {
+  if constexpr (std::is_integral_v<T> || std::is_enum_v<T> ||
+                std::is_pointer_v<T>) {
+    uint64_t bits;
+    if constexpr (std::is_pointer_v<T>)
+      bits = reinterpret_cast<std::uintptr_t>(value);
+    else
+      bits = static_cast<uint64_t>(value);
+    return hashCombine(seed, bits);
+  } else if constexpr (std::is_floating_point_v<T>) {
+    // +0.0 and -0.0 compare equal and must hash equal
+    return value == T(0) ? hashCombine(seed, 0)
+                          : hashBytes(&value, sizeof(T), seed);
+  } else if constexpr (HasHashFields<T>) {
+    // the declared fields win even when the bytes would do: a type may leave
+    // members out of its identity
+    return hash_detail::hashTuple(hashFields(value), seed);
+  } else if constexpr (IsTupleLike<T>::value) {
+    return hash_detail::hashTuple(value, seed);
+  } else if constexpr (std::ranges::contiguous_range<T> &&
+                       ByteHashable<std::ranges::range_value_t<T>>) {
+    return hashBytes(std::ranges::data(value),
+                     std::ranges::size(value) *
+                         sizeof(std::ranges::range_value_t<T>),
+                     seed);
+  } else if constexpr (std::ranges::input_range<T>) {
+    uint64_t h = seed;
+    std::size_t n = 0;
+    for (const auto &element : value) {
+      h = hashCombine(h, hashValue(element, h));
+      ++n;
+    }
+    return hashCombine(h, n);
+  } else if constexpr (ByteHashable<T>) {
+    return hashBytes(&value, sizeof(T), seed);
+  } else {
+    static_assert(sizeof(T) == 0,
+                  "no hashValue for T, describe it with hashFields()");
+    return 0;
+  }
+}
+
+// transparent hasher for unordered containers and FlatHashMap
+struct Hash {
+  using is_transparent = void;
+
+  template <typename T>
+    requires FastHashable<T> || StringLike<T>
+  std::size_t operator()(const T &value) const {
+    if constexpr (StringLike<T>)
+      return static_cast<std::size_t>(hashValue(std::string_view(value)));
+    else
+      return static_cast<std::size_t>(hashValue(value));
+  }
+};
@@ -3,6 +3,9 @@
 #include <optional>
 #include <string>
 
+#include "optional.hpp"
+#include "small_vector.hpp"
+
 std::optional<std::string> create(bool b) {
   if (b)
     return "Godzilla";
@@ -61,5 +64,47 @@ int main() {
       std::cout << "value no longer set\n";
   }
 
+  {
+    // compact optional: references and niches need no extra flag
+    using Handle = SentinelId<uint32_t, ~0u>;
+    static_assert(sizeof(Optional<std::string &>) == sizeof(void *));
+    static_assert(sizeof(Optional<NonNull<int>>) == sizeof(int *));
+    static_assert(sizeof(Optional<Handle>) == sizeof(uint32_t));
+    static_assert(sizeof(std::optional<uint32_t>) == 2 * sizeof(uint32_t));
+    // the flag fallback stays trivial for trivial payloads
+    static_assert(std::is_trivially_copyable_v<Optional<int>> &&
+                  std::is_trivially_destructible_v<Optional<int>>);
+
+    static std::string value = "Godzilla";
+    Optional<std::string &> ref = value;
+    ref->append(" vs Mothra");
+    std::cout << "Optional<T&> refers to " << *ref << '\n';
+
+    Optional<Handle> handle;
+    std::cout << "handle set? " << handle.has_value() << '\n';
+    handle = Handle{42};
+    auto next = handle.transform([](Handle h) { return h.value + 1; });
+    std::cout << "next handle " << next.value_or(0) << '\n';
+
+    Result<int, std::string> parsed = Failure{std::string("not a number")};
+    std::cout << "parsed: "
+              << (parsed ? std::to_string(*parsed) : parsed.error()) << '\n';
+    // switching alternatives builds the new one before the old one goes
+    Result<std::string, std::string> reply = std::string("pending");
+    reply = Result<std::string, std::string>(Failure{std::string("timeout")});
+    std::cout << "reply: " << (reply ? *reply : reply.error()) << '\n';
+  }
+
+  {
+    // relocatable payloads are moved by memcpy when the buffer grows
+    static_assert(is_trivially_relocatable_v<Optional<NonNull<int>>>);
+    SmallVector<Optional<NonNull<int>>, 4> slots;
+    int x = 7;
+    for (int i = 0; i < 6; ++i)
+      slots.push_back(i % 2 ? Optional<NonNull<int>>(&x) : std::nullopt);
+    std::cout << "slots: " << slots.size() << ", inline " << slots.inlined()
+              << '\n';
+  }
+
   return 0;
 }
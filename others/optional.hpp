@@ -0,0 +1,525 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/**
+ compact optional / result types
+
+ 1. Optional<T&> is a single pointer, nullptr means empty;
+ 2. a type with a spare bit pattern (a niche) keeps the empty state inside its
+    own storage, so Optional<T> has the same size as T;
+ 3. everything else falls back to a value + flag, laid out like std::optional;
+ 4. trivially relocatable payloads can be moved with memcpy by containers, see
+    relocate() and SmallVector.
+*/
+
+// niche customization point, specialize for types that own a sentinel value:
+//   static constexpr bool available = true;
+//   static constexpr T empty();           // the sentinel, never a real value
+//   static constexpr bool isEmpty(const T &value);
+template <typename T> struct NicheTraits {
+  static constexpr bool available = false;
+};
+
+template <typename T>
+concept HasNiche =
+    NicheTraits<T>::available && std::is_trivially_copyable_v<T>;
+
+// a pointer that is never null, which gives nullptr away as a niche
+template <typename T> struct NonNull {
+  T *ptr;
+
+  constexpr NonNull(T *ptr) : ptr(ptr) {}
+  NonNull(std::nullptr_t) = delete;
+
+  constexpr T *get() const { return ptr; }
+  constexpr T &operator*() const { return *ptr; }
+  constexpr T *operator->() const { return ptr; }
+  constexpr bool operator==(const NonNull &) const = default;
+
+private:
+  template <typename> friend struct NicheTraits;
+  struct NullTag {};
+  constexpr NonNull(NullTag) : ptr(nullptr) {}
+};
+
+template <typename T> struct NicheTraits<NonNull<T>> {
+  static constexpr bool available = true;
+  static constexpr NonNull<T> empty() {
+    return NonNull<T>(typename NonNull<T>::NullTag{});
+  }
+  static constexpr bool isEmpty(const NonNull<T> &value) {
+    return value.ptr == nullptr;
+  }
+};
+
+// integral id with a reserved sentinel, e.g. SentinelId<uint32_t, ~0u>
+template <typename T, T Sentinel> struct SentinelId {
+  static_assert(std::is_integral_v<T>);
+  T value;
+
+  constexpr bool operator==(const SentinelId &) const = default;
+};
+
+template <typename T, T Sentinel> struct NicheTraits<SentinelId<T, Sentinel>> {
+  static constexpr bool available = true;
+  static constexpr SentinelId<T, Sentinel> empty() { return {Sentinel}; }
+  static constexpr bool isEmpty(const SentinelId<T, Sentinel> &value) {
+    return value.value == Sentinel;
+  }
+};
+
+// relocation = move construct into new storage + destroy the source
+template <typename T>
+struct IsTriviallyRelocatable
+    : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T>
+struct IsTriviallyRelocatable<std::unique_ptr<T>> : std::true_type {};
+
+// std::pair is never trivially copyable (its assignment is user-provided),
+// but relocates like its members, const ones included
+template <typename A, typename B>
+struct IsTriviallyRelocatable<std::pair<A, B>>
+    : std::bool_constant<
+          IsTriviallyRelocatable<std::remove_const_t<A>>::value &&
+          IsTriviallyRelocatable<std::remove_const_t<B>>::value> {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v =
+    IsTriviallyRelocatable<T>::value;
+
+// relocate [first, first + count) into uninitialized storage at dest, the
+// source range is left uninitialized; ranges must not overlap
+template <typename T> void relocate(T *first, std::size_t count, T *dest) {
+  if constexpr (is_trivially_relocatable_v<T>) {
+    if (count != 0)
+      std::memcpy(static_cast<void *>(dest), static_cast<const void *>(first),
+                  count * sizeof(T));
+  } else {
+    for (std::size_t i = 0; i < count; ++i) {
+      std::construct_at(dest + i, std::move(first[i]));
+      std::destroy_at(first + i);
+    }
+  }
+}
+
+template <typename T> class Optional;
+
+template <typename T> struct IsOptional : std::false_type {};
+template <typename T> struct IsOptional<Optional<T>> : std::true_type {};
+
+namespace detail {
+// value + flag, same layout as std::optional; the special members are the
+// defaulted trivial ones whenever T's are, so Optional<int> stays trivially
+// copyable like std::optional<int>
+template <typename T> struct FlagStorage {
+  union {
+    char dummy_;
+    T value_;
+  };
+  bool engaged_ = false;
+
+  constexpr FlagStorage() : dummy_() {}
+  FlagStorage(const FlagStorage &)
+    requires std::is_trivially_copy_constructible_v<T>
+  = default;
+  constexpr FlagStorage(const FlagStorage &other) : dummy_() {
+    if (other.engaged_)
+      construct(other.value_);
+  }
+  FlagStorage(FlagStorage &&)
+    requires std::is_trivially_move_constructible_v<T>
+  = default;
+  constexpr FlagStorage(FlagStorage &&other) noexcept(
+      std::is_nothrow_move_constructible_v<T>)
+      : dummy_() {
+    if (other.engaged_)
+      construct(std::move(other.value_));
+  }
+  FlagStorage &operator=(const FlagStorage &)
+    requires std::is_trivially_copy_assignable_v<T> &&
+             std::is_trivially_copy_constructible_v<T> &&
+             std::is_trivially_destructible_v<T>
+  = default;
+  constexpr FlagStorage &operator=(const FlagStorage &other) {
+    if (this != &other) {
+      if (other.engaged_)
+        assign(other.value_);
+      else
+        reset();
+    }
+    return *this;
+  }
+  FlagStorage &operator=(FlagStorage &&)
+    requires std::is_trivially_move_assignable_v<T> &&
+             std::is_trivially_move_constructible_v<T> &&
+             std::is_trivially_destructible_v<T>
+  = default;
+  constexpr FlagStorage &operator=(FlagStorage &&other) noexcept(
+      std::is_nothrow_move_assignable_v<T>) {
+    if (other.engaged_)
+      assign(std::move(other.value_));
+    else
+      reset();
+    return *this;
+  }
+  ~FlagStorage()
+    requires std::is_trivially_destructible_v<T>
+  = default;
+  constexpr ~FlagStorage() { reset(); }
+
+  constexpr bool engaged() const { return engaged_; }
+  constexpr T &get() { return value_; }
+  constexpr const T &get() const { return value_; }
+
+  template <typename... Args> constexpr void construct(Args &&...args) {
+    std::construct_at(std::addressof(value_), std::forward<Args>(args)...);
+    engaged_ = true;
+  }
+  template <typename U> constexpr void assign(U &&value) {
+    if (engaged_)
+      value_ = std::forward<U>(value);
+    else
+      construct(std::forward<U>(value));
+  }
+  constexpr void reset() {
+    if (engaged_) {
+      std::destroy_at(std::addressof(value_));
+      engaged_ = false;
+    }
+  }
+};
+
+// the empty state lives in the niche of T, no extra flag
+template <typename T> struct NicheStorage {
+  T value_ = NicheTraits<T>::empty();
+
+  constexpr bool engaged() const { return !NicheTraits<T>::isEmpty(value_); }
+  constexpr T &get() { return value_; }
+  constexpr const T &get() const { return value_; }
+
+  template <typename... Args> constexpr void construct(Args &&...args) {
+    value_ = T(std::forward<Args>(args)...);
+  }
+  template <typename U> constexpr void assign(U &&value) {
+    value_ = std::forward<U>(value);
+  }
+  constexpr void reset() { value_ = NicheTraits<T>::empty(); }
+};
+
+template <typename T>
+using OptionalStorage =
+    std::conditional_t<HasNiche<T>, NicheStorage<T>, FlagStorage<T>>;
+} // namespace detail
+
+template <typename T> class Optional {
+  static_assert(!std::is_reference_v<T>);
+  detail::OptionalStorage<T> storage_;
+
+public:
+  using value_type = T;
+
+  constexpr Optional() = default;
+  constexpr Optional(std::nullopt_t) {}
+
+  template <typename U = T>
+    requires std::is_constructible_v<T, U &&> &&
+             (!std::is_same_v<std::remove_cvref_t<U>, Optional>) &&
+             (!std::is_same_v<std::remove_cvref_t<U>, std::nullopt_t>)
+  constexpr Optional(U &&value) {
+    storage_.construct(std::forward<U>(value));
+  }
+
+  template <typename... Args>
+  constexpr explicit Optional(std::in_place_t, Args &&...args) {
+    storage_.construct(std::forward<Args>(args)...);
+  }
+
+  constexpr Optional &operator=(std::nullopt_t) {
+    reset();
+    return *this;
+  }
+
+  constexpr bool has_value() const { return storage_.engaged(); }
+  constexpr explicit operator bool() const { return has_value(); }
+
+  constexpr T &operator*() & { return storage_.get(); }
+  constexpr const T &operator*() const & { return storage_.get(); }
+  constexpr T &&operator*() && { return std::move(storage_.get()); }
+  constexpr T *operator->() { return std::addressof(storage_.get()); }
+  constexpr const T *operator->() const {
+    return std::addressof(storage_.get());
+  }
+
+  constexpr T &value() & {
+    if (!has_value())
+      throw std::bad_optional_access();
+    return storage_.get();
+  }
+  constexpr const T &value() const & {
+    if (!has_value())
+      throw std::bad_optional_access();
+    return storage_.get();
+  }
+  constexpr T &&value() && { return std::move(value()); }
+
+  template <typename U> constexpr T value_or(U &&fallback) const & {
+    return has_value() ? storage_.get()
+                       : static_cast<T>(std::forward<U>(fallback));
+  }
+
+  template <typename... Args> constexpr T &emplace(Args &&...args) {
+    reset();
+    storage_.construct(std::forward<Args>(args)...);
+    return storage_.get();
+  }
+
+  constexpr void reset() { storage_.reset(); }
+
+  // monadic operations, f :: T -> Optional<U>
+  template <typename F> constexpr auto and_then(F &&f) const & {
+    using R = std::remove_cvref_t<std::invoke_result_t<F, const T &>>;
+    static_assert(IsOptional<R>::value, "and_then must return an Optional");
+    return has_value() ? std::invoke(std::forward<F>(f), storage_.get()) : R{};
+  }
+
+  // f :: T -> U
+  template <typename F> constexpr auto transform(F &&f) const & {
+    using U = std::remove_cv_t<std::invoke_result_t<F, const T &>>;
+    return has_value()
+               ? Optional<U>(std::invoke(std::forward<F>(f), storage_.get()))
+               : Optional<U>{};
+  }
+
+  friend constexpr bool operator==(const Optional &lhs, const Optional &rhs) {
+    if (lhs.has_value() != rhs.has_value())
+      return false;
+    return !lhs.has_value() || *lhs == *rhs;
+  }
+  friend constexpr bool operator==(const Optional &lhs, std::nullopt_t) {
+    return !lhs.has_value();
+  }
+};
+
+template <typename T> Optional(T) -> Optional<T>;
+
+// optional reference, stored as a single pointer
+template <typename T> class Optional<T &> {
+  T *ptr_ = nullptr;
+
+public:
+  using value_type = T &;
+
+  constexpr Optional() = default;
+  constexpr Optional(std::nullopt_t) {}
+  constexpr Optional(T &ref) : ptr_(std::addressof(ref)) {}
+  Optional(T &&) = delete;
+
+  constexpr Optional &operator=(std::nullopt_t) {
+    ptr_ = nullptr;
+    return *this;
+  }
+
+  constexpr bool has_value() const { return ptr_ != nullptr; }
+  constexpr explicit operator bool() const { return has_value(); }
+
+  constexpr T &operator*() const { return *ptr_; }
+  constexpr T *operator->() const { return ptr_; }
+  constexpr T &value() const {
+    if (!has_value())
+      throw std::bad_optional_access();
+    return *ptr_;
+  }
+  constexpr T &value_or(T &fallback) const {
+    return has_value() ? *ptr_ : fallback;
+  }
+
+  constexpr T &emplace(T &ref) {
+    ptr_ = std::addressof(ref);
+    return ref;
+  }
+  constexpr void reset() { ptr_ = nullptr; }
+
+  template <typename F> constexpr auto and_then(F &&f) const {
+    using R = std::remove_cvref_t<std::invoke_result_t<F, T &>>;
+    static_assert(IsOptional<R>::value, "and_then must return an Optional");
+    return has_value() ? std::invoke(std::forward<F>(f), *ptr_) : R{};
+  }
+
+  template <typename F> constexpr auto transform(F &&f) const {
+    using U = std::remove_cv_t<std::invoke_result_t<F, T &>>;
+    return has_value() ? Optional<U>(std::invoke(std::forward<F>(f), *ptr_))
+                       : Optional<U>{};
+  }
+};
+
+template <typename T>
+struct IsTriviallyRelocatable<Optional<T>>
+    : std::bool_constant<is_trivially_relocatable_v<T>> {};
+
+template <typename T>
+struct IsTriviallyRelocatable<Optional<T &>> : std::true_type {};
+
+// error wrapper used to construct a failed Result
+template <typename E> struct Failure {
+  E error;
+};
+template <typename E> Failure(E) -> Failure<E>;
+
+template <typename T, typename E> class Result;
+
+template <typename T> struct IsResult : std::false_type {};
+template <typename T, typename E>
+struct IsResult<Result<T, E>> : std::true_type {};
+
+// value or error, both stored in place
+template <typename T, typename E> class Result {
+  union {
+    T value_;
+    E error_;
+  };
+  bool ok_;
+
+  template <typename Other> constexpr void copyFrom(Other &&other) {
+    if (other.ok_)
+      std::construct_at(std::addressof(value_),
+                        std::forward<Other>(other).value_);
+    else
+      std::construct_at(std::addressof(error_),
+                        std::forward<Other>(other).error_);
+    ok_ = other.ok_;
+  }
+
+  constexpr void destroy() {
+    if (ok_)
+      std::destroy_at(std::addressof(value_));
+    else
+      std::destroy_at(std::addressof(error_));
+  }
+
+  // assignment keeps the held alternative when the new one throws: a
+  // matching alternative is assigned, a different one is built before the
+  // old one goes (std::expected's reinit with a backup)
+  template <typename Other> constexpr void assignFrom(Other &&other) {
+    if (ok_ && other.ok_)
+      value_ = std::forward<Other>(other).value_;
+    else if (!ok_ && !other.ok_)
+      error_ = std::forward<Other>(other).error_;
+    else if (other.ok_)
+      reinit(value_, error_, std::forward<Other>(other).value_);
+    else
+      reinit(error_, value_, std::forward<Other>(other).error_);
+    ok_ = other.ok_;
+  }
+
+  template <typename New, typename Old, typename Arg>
+  static constexpr void reinit(New &next, Old &old, Arg &&arg) {
+    if constexpr (std::is_nothrow_constructible_v<New, Arg &&>) {
+      std::destroy_at(std::addressof(old));
+      std::construct_at(std::addressof(next), std::forward<Arg>(arg));
+    } else if constexpr (std::is_nothrow_move_constructible_v<New>) {
+      New temporary(std::forward<Arg>(arg));
+      std::destroy_at(std::addressof(old));
+      std::construct_at(std::addressof(next), std::move(temporary));
+    } else {
+      static_assert(std::is_nothrow_move_constructible_v<Old>,
+                    "Result assignment needs T or E nothrow movable");
+      Old backup(std::move(old));
+      std::destroy_at(std::addressof(old));
+      try {
+        std::construct_at(std::addressof(next), std::forward<Arg>(arg));
+      } catch (...) {
+        std::construct_at(std::addressof(old), std::move(backup));
+        throw;
+      }
+    }
+  }
+
+public:
+  using value_type = T;
+  using error_type = E;
+
+  template <typename U = T>
+    requires std::is_constructible_v<T, U &&> &&
+             (!std::is_same_v<std::remove_cvref_t<U>, Result>)
+  constexpr Result(U &&value) : value_(std::forward<U>(value)), ok_(true) {}
+
+  template <typename G>
+  constexpr Result(Failure<G> failure)
+      : error_(std::move(failure.error)), ok_(false) {}
+
+  constexpr Result(const Result &other) { copyFrom(other); }
+  constexpr Result(Result &&other) noexcept(
+      std::is_nothrow_move_constructible_v<T> &&
+      std::is_nothrow_move_constructible_v<E>) {
+    copyFrom(std::move(other));
+  }
+  constexpr Result &operator=(const Result &other) {
+    if (this != &other)
+      assignFrom(other);
+    return *this;
+  }
+  constexpr Result &operator=(Result &&other) noexcept(
+      std::is_nothrow_move_constructible_v<T> &&
+      std::is_nothrow_move_assignable_v<T> &&
+      std::is_nothrow_move_constructible_v<E> &&
+      std::is_nothrow_move_assignable_v<E>) {
+    if (this != &other)
+      assignFrom(std::move(other));
+    return *this;
+  }
+  constexpr ~Result() { destroy(); }
+
+  constexpr bool has_value() const { return ok_; }
+  constexpr explicit operator bool() const { return ok_; }
+
+  constexpr T &operator*() & { return value_; }
+  constexpr const T &operator*() const & { return value_; }
+  constexpr T *operator->() { return std::addressof(value_); }
+  constexpr const T *operator->() const { return std::addressof(value_); }
+
+  constexpr T &value() & {
+    if (!ok_)
+      throw std::logic_error("Result holds an error");
+    return value_;
+  }
+  constexpr const T &value() const & {
+    if (!ok_)
+      throw std::logic_error("Result holds an error");
+    return value_;
+  }
+  constexpr E &error() & { return error_; }
+  constexpr const E &error() const & { return error_; }
+
+  template <typename U> constexpr T value_or(U &&fallback) const & {
+    return ok_ ? value_ : static_cast<T>(std::forward<U>(fallback));
+  }
+
+  // f :: T -> Result<U, E>
+  template <typename F> constexpr auto and_then(F &&f) const & {
+    using R = std::remove_cvref_t<std::invoke_result_t<F, const T &>>;
+    static_assert(IsResult<R>::value, "and_then must return a Result");
+    return ok_ ? std::invoke(std::forward<F>(f), value_) : R(Failure{error_});
+  }
+
+  // f :: T -> U
+  template <typename F> constexpr auto transform(F &&f) const & {
+    using U = std::remove_cv_t<std::invoke_result_t<F, const T &>>;
+    return ok_ ? Result<U, E>(std::invoke(std::forward<F>(f), value_))
+               : Result<U, E>(Failure{error_});
+  }
+};
+
+template <typename T, typename E>
+struct IsTriviallyRelocatable<Result<T, E>>
+    : std::bool_constant<is_trivially_relocatable_v<T> &&
+                         is_trivially_relocatable_v<E>> {};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "optional.hpp"
+
+/**
+ vector with N elements of inline storage, spills to the heap when it grows
+ beyond that. growth relocates the elements, which is a single memcpy for
+ trivially relocatable payloads (see IsTriviallyRelocatable).
+*/
+template <typename T, std::size_t N> class SmallVector {
+  T *data_;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = N;
+  alignas(T) std::byte inline_[N == 0 ? 1 : N * sizeof(T)];
+
+  T *inlineData() { return reinterpret_cast<T *>(inline_); }
+  bool isInline() const {
+    return data_ == reinterpret_cast<const T *>(inline_);
+  }
+
+  void grow(std::size_t capacity) {
+    T *storage = static_cast<T *>(
+        ::operator new(capacity * sizeof(T), std::align_val_t{alignof(T)}));
+    relocate(data_, size_, storage);
+    release();
+    data_ = storage;
+    capacity_ = capacity;
+  }
+
+  void release() {
+    if (!isInline())
+      ::operator delete(data_, std::align_val_t{alignof(T)});
+    data_ = inlineData();
+    capacity_ = N;
+  }
+
+  // take over the elements of other, leaves other empty
+  void steal(SmallVector &other) {
+    if (other.isInline()) {
+      relocate(other.data_, other.size_, data_);
+    } else {
+      data_ = other.data_;
+      capacity_ = other.capacity_;
+      other.data_ = other.inlineData();
+      other.capacity_ = N;
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+  }
+
+public:
+  using value_type = T;
+  using iterator = T *;
+  using const_iterator = const T *;
+
+  SmallVector() : data_(inlineData()) {}
+  SmallVector(std::initializer_list<T> init) : SmallVector() {
+    reserve(init.size());
+    for (const auto &value : init)
+      push_back(value);
+  }
+  SmallVector(const SmallVector &other) : SmallVector() {
+    reserve(other.size_);
+    for (const auto &value : other)
+      push_back(value);
+  }
+  SmallVector(SmallVector &&other) noexcept : SmallVector() { steal(other); }
+
+  SmallVector &operator=(const SmallVector &other) {
+    if (this != &other) {
+      clear();
+      reserve(other.size_);
+      for (const auto &value : other)
+        push_back(value);
+    }
+    return *this;
+  }
+  SmallVector &operator=(SmallVector &&other) noexcept {
+    if (this != &other) {
+      clear();
+      release();
+      steal(other);
+    }
+    return *this;
+  }
+
+  ~SmallVector() {
+    clear();
+    release();
+  }
+
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0; }
+  bool inlined() const { return isInline(); }
+
+  T *data() { return data_; }
+  const T *data() const { return data_; }
+  T *begin() { return data_; }
+  T *end() { return data_ + size_; }
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+
+  T &operator[](std::size_t index) { return data_[index]; }
+  const T &operator[](std::size_t index) const { return data_[index]; }
+  T &back() { return data_[size_ - 1]; }
+  const T &back() const { return data_[size_ - 1]; }
+
+  void reserve(std::size_t capacity) {
+    if (capacity > capacity_)
+      grow(capacity);
+  }
+
+  template <typename... Args> T &emplace_back(Args &&...args) {
+    if (size_ == capacity_) {
+      // construct first, args may alias an element that is about to move
+      T value(std::forward<Args>(args)...);
+      grow(capacity_ * 2 + 1);
+      return *std::construct_at(data_ + size_++, std::move(value));
+    }
+    return *std::construct_at(data_ + size_++, std::forward<Args>(args)...);
+  }
+  void push_back(const T &value) { emplace_back(value); }
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  void pop_back() { std::destroy_at(data_ + --size_); }
+
+  void clear() {
+    std::destroy(data_, data_ + size_);
+    size_ = 0;
+  }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ fork join thread pool
+
+ 1. parallelFor(n, f) runs f(i) for every i in [0, n) on the workers and on
+    the calling thread, and returns once all calls are done; indices are
+    claimed one at a time from an atomic counter, so uneven items balance
+    themselves; f must not throw;
+ 2. the caller always works on its own job, a parallelFor nested inside an
+    item completes even when every worker is busy with the outer one;
+ 3. jobs live on the caller's stack, the queue only holds pointers; a job
+    leaves the queue when its last index has been claimed and parallelFor
+    returns once no worker is inside it any more;
+ 4. global() is a lazily created pool with one worker less than the
+    hardware threads, the caller being the last one.
+*/
+
+class ThreadPool {
+  struct Job {
+    void (*run)(void *, std::size_t);
+    void *context;
+    std::size_t count;
+    std::atomic<std::size_t> next{0};
+    unsigned workers = 0; // inside work(), guarded by the pool mutex
+
+    // claims and runs indices until none is left
+    void work() {
+      for (std::size_t i; (i = next.fetch_add(1)) < count;)
+        run(context, i);
+    }
+  };
+
+public:
+  explicit ThreadPool(
+      unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+    for (unsigned i = 1; i < threads; ++i)
+      workers_.emplace_back([this] { loop(); });
+  }
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_)
+      worker.join();
+  }
+
+  // threads taking part in a parallelFor, the caller included
+  unsigned size() const { return static_cast<unsigned>(workers_.size()) + 1; }
+
+  template <typename F> void parallelFor(std::size_t count, F &&f) {
+    if (count == 0)
+      return;
+    if (count == 1 || workers_.empty()) {
+      for (std::size_t i = 0; i < count; ++i)
+        f(i);
+      return;
+    }
+    using Fn = std::remove_reference_t<F>;
+    Job job{[](void *context, std::size_t i) {
+              (*static_cast<Fn *>(context))(i);
+            },
+            const_cast<void *>(static_cast<const void *>(&f)), count};
+    {
+      std::lock_guard lock(mutex_);
+      jobs_.push_back(&job);
+    }
+    wake_.notify_all();
+    job.work();
+    // every index is claimed; once off the queue no worker can join, wait
+    // for the ones still running an item
+    std::unique_lock lock(mutex_);
+    if (auto it = std::find(jobs_.begin(), jobs_.end(), &job);
+        it != jobs_.end())
+      jobs_.erase(it);
+    finished_.wait(lock, [&job] { return job.workers == 0; });
+  }
+
+  static ThreadPool &global() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+private:
+  void loop() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (stop_)
+        return;
+      Job *job = jobs_.front();
+      if (job->next.load() >= job->count) {
+        jobs_.pop_front(); // exhausted, its caller is finishing it
+        continue;
+      }
+      ++job->workers;
+      lock.unlock();
+      job->work();
+      lock.lock();
+      if (--job->workers == 0)
+        finished_.notify_all();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;     // workers: a job was queued
+  std::condition_variable finished_; // callers: a worker left a job
+  std::deque<Job *> jobs_;
+  bool stop_ = false;
+};
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sort.hpp"
+
+// the sorts of a frame: Morton codes of BVH primitives, strand indices
+// ordered by the pass that simulates them, and a depth sort of floats;
+// each result is checked against std::sort / std::stable_sort
+
+template <typename F> double timed(F &&f) {
+  auto begin = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+uint32_t spread(uint32_t v) {
+  v &= 0x3ff;
+  v = (v | v << 16) & 0x030000ff;
+  v = (v | v << 8) & 0x0300f00f;
+  v = (v | v << 4) & 0x030c30c3;
+  v = (v | v << 2) & 0x09249249;
+  return v;
+}
+
+bool report(const std::string &what, double ms, double reference, bool ok) {
+  std::cout << what << ": " << ms << " ms (std " << reference << " ms) "
+            << (ok ? "ok" : "MISMATCH") << std::endl;
+  return ok;
+}
+
+// sort [elements] [threads]
+int main(int argc, char *argv[]) {
+  std::size_t n = argc > 1 ? std::max(1, std::atoi(argv[1])) : 4 << 20;
+  unsigned threads = argc > 2 ? std::max(1, std::atoi(argv[2]))
+                              : ThreadPool::global().size();
+  ThreadPool pool(threads);
+  std::mt19937_64 rng(7);
+  bool ok = true;
+  std::cout << n << " elements, " << pool.size() << " threads" << std::endl;
+
+  std::vector<uint32_t> morton(n);
+  for (auto &code : morton)
+    code = spread(rng() % 1024) | spread(rng() % 1024) << 1 |
+           spread(rng() % 1024) << 2;
+  auto expected = morton;
+  double reference =
+      timed([&] { std::sort(expected.begin(), expected.end()); });
+  double ms = timed([&] { radixSort(morton, pool); });
+  ok &= report("radixSort morton", ms, reference, morton == expected);
+
+  // strand i is simulated by pass passIds[i], strands keep their order
+  std::vector<uint16_t> passIds(n);
+  std::vector<uint32_t> strands(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    passIds[i] = static_cast<uint16_t>(rng() % 300);
+    strands[i] = static_cast<uint32_t>(i);
+  }
+  std::vector<std::pair<uint16_t, uint32_t>> pairs(n);
+  for (std::size_t i = 0; i < n; ++i)
+    pairs[i] = {passIds[i], strands[i]};
+  auto mergeKeys = passIds;
+  auto mergeValues = strands;
+  reference = timed([&] {
+    std::stable_sort(pairs.begin(), pairs.end(),
+                     [](auto &a, auto &b) { return a.first < b.first; });
+  });
+  auto matches = [&](const auto &keys, const auto &values) {
+    for (std::size_t i = 0; i < n; ++i)
+      if (keys[i] != pairs[i].first || values[i] != pairs[i].second)
+        return false;
+    return true;
+  };
+  ms = timed([&] { radixSortByKey(passIds, strands, pool); });
+  ok &= report("radixSortByKey pass ids", ms, reference,
+               matches(passIds, strands));
+  ms = timed([&] {
+    mergeSortByKey(mergeKeys, mergeValues, std::ranges::less{}, pool);
+  });
+  ok &= report("mergeSortByKey pass ids", ms, reference,
+               matches(mergeKeys, mergeValues));
+
+  // back to front
+  std::vector<float> depths(n);
+  for (auto &depth : depths)
+    depth = std::uniform_real_distribution<float>(0.1f, 1000.0f)(rng);
+  auto descending = depths;
+  reference = timed(
+      [&] { std::sort(descending.begin(), descending.end(), std::greater{}); });
+  ms = timed([&] { mergeSort(depths, std::ranges::greater{}, {}, pool); });
+  ok &= report("mergeSort depths", ms, reference, depths == descending);
+
+  // pass names with their submission order: elements that own memory, on a
+  // pool of its own so the merges split pairs even with few cores
+  using Named = std::pair<std::string, std::size_t>;
+  std::vector<Named> named(n);
+  for (std::size_t i = 0; i < n; ++i)
+    named[i] = {"pass" + std::to_string(rng() % 5000), i};
+  auto stable = named;
+  reference = timed(
+      [&] { std::ranges::stable_sort(stable, std::less{}, &Named::first); });
+  ThreadPool four(4);
+  ms = timed(
+      [&] { mergeSort(named, std::ranges::less{}, &Named::first, four); });
+  ok &= report("mergeSort pass names", ms, reference, named == stable);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../others/thread_pool.hpp"
+
+/**
+ parallel sorting as range algorithms
+
+ 1. radixSort(range) is a stable LSD radix sort with byte digits over
+    contiguous ranges of integers or floats; keys are mapped to unsigned
+    integers of the same order on the fly (sign bit flipped, negative floats
+    inverted), so -0.0 sorts before 0.0 and NaNs go to the ends by sign;
+ 2. one fused pass counts all digits at once and digits that are the same
+    for every key (high bytes of small pass ids, Morton codes of a flat
+    scene) are skipped; each remaining digit is a parallel count over blocks
+    of the input followed by a parallel stable scatter into a buffer;
+ 3. mergeSort(range, comp, proj) is a stable merge sort for any comparator:
+    blocks are sorted in parallel, then merged pairwise, every merge split
+    into independent parts at co-ranks found by binary search so the last
+    rounds keep all threads busy as well;
+ 4. radixSortByKey() and mergeSortByKey() sort a key range and move the
+    elements of a separate value range along, the values are never
+    compared; mergeSortByKey() sorts a permutation and gathers once;
+ 5. everything runs on a ThreadPool, ThreadPool::global() by default, and
+    returns the end iterator like std::ranges::sort.
+*/
+
+namespace sort_detail {
+template <typename K> struct RadixKey {};
+
+template <std::unsigned_integral K> struct RadixKey<K> {
+  using Bits = K;
+  static Bits bits(K key) { return key; }
+};
+
+template <std::signed_integral K> struct RadixKey<K> {
+  using Bits = std::make_unsigned_t<K>;
+  static Bits bits(K key) {
+    return static_cast<Bits>(key) ^ (Bits(1) << (8 * sizeof(K) - 1));
+  }
+};
+
+template <std::floating_point K>
+  requires(sizeof(K) == 4 || sizeof(K) == 8)
+struct RadixKey<K> {
+  using Bits = std::conditional_t<sizeof(K) == 4, uint32_t, uint64_t>;
+  static Bits bits(K key) {
+    Bits b = std::bit_cast<Bits>(key);
+    constexpr Bits sign = Bits(1) << (8 * sizeof(K) - 1);
+    return b & sign ? ~b : b | sign;
+  }
+};
+
+// no values to carry along
+struct NoValue {};
+
+// fewer elements are sorted by insertion, more are split across threads in
+// blocks of at least grain elements
+inline constexpr std::size_t insertionLimit = 64;
+inline constexpr std::size_t grain = 1 << 16;
+
+inline std::size_t blockCount(std::size_t n, const ThreadPool &pool) {
+  return std::clamp<std::size_t>(n / grain, 1, pool.size());
+}
+
+template <typename K, typename V>
+void radixInsertion(K *keys, V *values, std::size_t n) {
+  using Key = RadixKey<K>;
+  for (std::size_t i = 1; i < n; ++i) {
+    K key = keys[i];
+    auto bits = Key::bits(key);
+    std::size_t j = i;
+    if constexpr (std::is_same_v<V, NoValue>) {
+      for (; j > 0 && Key::bits(keys[j - 1]) > bits; --j)
+        keys[j] = keys[j - 1];
+    } else {
+      V value = std::move(values[i]);
+      for (; j > 0 && Key::bits(keys[j - 1]) > bits; --j) {
+        keys[j] = keys[j - 1];
+        values[j] = std::move(values[j - 1]);
+      }
+      values[j] = std::move(value);
+    }
+    keys[j] = key;
+  }
+}
+
+template <typename K, typename V>
+void radixSort(K *keys, V *values, std::size_t n, ThreadPool &pool) {
+  using Key = RadixKey<K>;
+  constexpr std::size_t digits = sizeof(K);
+  using Histogram = std::array<std::size_t, 256>;
+  constexpr bool carry = !std::is_same_v<V, NoValue>;
+
+  if (n <= insertionLimit) {
+    radixInsertion(keys, values, n);
+    return;
+  }
+
+  std::size_t blocks = blockCount(n, pool);
+  auto begin = [&](std::size_t b) { return n * b / blocks; };
+
+  // counts of every digit in one read, per block; the digit 0 counts are
+  // also the per block counts of the first pass
+  std::vector<Histogram> counts(blocks * digits, Histogram{});
+  pool.parallelFor(blocks, [&](std::size_t b) {
+    Histogram *h = &counts[b * digits];
+    for (std::size_t i = begin(b), end = begin(b + 1); i < end; ++i) {
+      auto bits = Key::bits(keys[i]);
+      for (std::size_t d = 0; d < digits; ++d)
+        ++h[d][(bits >> (8 * d)) & 255];
+    }
+  });
+  std::vector<std::size_t> passes;
+  for (std::size_t d = 0; d < digits; ++d) {
+    bool trivial = false;
+    for (std::size_t v = 0; v < 256 && !trivial; ++v) {
+      std::size_t total = 0;
+      for (std::size_t b = 0; b < blocks; ++b)
+        total += counts[b * digits + d][v];
+      trivial = total == n;
+    }
+    if (!trivial)
+      passes.push_back(d);
+  }
+  if (passes.empty())
+    return;
+
+  auto keyBuffer = std::make_unique_for_overwrite<K[]>(n);
+  std::unique_ptr<V[]> valueBuffer;
+  if constexpr (carry)
+    valueBuffer = std::make_unique<V[]>(n);
+  K *srcKeys = keys, *dstKeys = keyBuffer.get();
+  V *srcValues = values, *dstValues = valueBuffer.get();
+
+  std::vector<Histogram> offsets(blocks);
+  for (std::size_t pass = 0; pass < passes.size(); ++pass) {
+    std::size_t d = passes[pass];
+    unsigned shift = static_cast<unsigned>(8 * d);
+    if (pass == 0) {
+      for (std::size_t b = 0; b < blocks; ++b)
+        offsets[b] = counts[b * digits + d];
+    } else {
+      pool.parallelFor(blocks, [&](std::size_t b) {
+        Histogram &h = offsets[b];
+        h.fill(0);
+        for (std::size_t i = begin(b), end = begin(b + 1); i < end; ++i)
+          ++h[(Key::bits(srcKeys[i]) >> shift) & 255];
+      });
+    }
+    // bucket major, block minor: block b's keys of a digit follow those of
+    // the blocks before it, which keeps the sort stable
+    std::size_t running = 0;
+    for (std::size_t v = 0; v < 256; ++v)
+      for (std::size_t b = 0; b < blocks; ++b) {
+        std::size_t count = offsets[b][v];
+        offsets[b][v] = running;
+        running += count;
+      }
+    pool.parallelFor(blocks, [&](std::size_t b) {
+      Histogram &next = offsets[b];
+      for (std::size_t i = begin(b), end = begin(b + 1); i < end; ++i) {
+        std::size_t to = next[(Key::bits(srcKeys[i]) >> shift) & 255]++;
+        dstKeys[to] = srcKeys[i];
+        if constexpr (carry)
+          dstValues[to] = std::move(srcValues[i]);
+      }
+    });
+    std::swap(srcKeys, dstKeys);
+    std::swap(srcValues, dstValues);
+  }
+
+  if (srcKeys != keys)
+    pool.parallelFor(blocks, [&](std::size_t b) {
+      std::copy(srcKeys + begin(b), srcKeys + begin(b + 1), keys + begin(b));
+      if constexpr (carry)
+        std::move(srcValues + begin(b), srcValues + begin(b + 1),
+                  values + begin(b));
+    });
+}
+
+// the split of merging a and b where the first k outputs end: i elements of
+// a and k - i of b; on ties a goes first
+template <typename A, typename B, typename Less>
+std::size_t coRank(std::size_t k, A a, std::size_t na, B b, std::size_t nb,
+                   Less &less) {
+  std::size_t lo = k > nb ? k - nb : 0, hi = std::min(k, na);
+  while (lo < hi) {
+    std::size_t i = lo + (hi - lo) / 2, j = k - i;
+    if (j > 0 && !less(b[j - 1], a[i]))
+      lo = i + 1; // a[i] belongs before b[j - 1]
+    else
+      hi = i;
+  }
+  return lo;
+}
+
+// merges neighbouring runs of src into dst; runs holds the run boundaries
+// and is updated to those of the merged runs
+template <typename Src, typename Dst, typename Less>
+void mergeRound(Src src, Dst dst, std::vector<std::size_t> &runs, Less &less,
+                ThreadPool &pool) {
+  std::size_t count = runs.size() - 1, pairs = count / 2;
+  std::size_t parts =
+      std::max<std::size_t>(1, pool.size() / std::max<std::size_t>(pairs, 1));
+  // all co-ranks first: the searches read elements anywhere in a pair, which
+  // the moving merges below would race with
+  std::vector<std::size_t> splits(pairs * (parts + 1));
+  pool.parallelFor(splits.size(), [&](std::size_t task) {
+    std::size_t pair = task / (parts + 1), part = task % (parts + 1);
+    std::size_t lo = runs[2 * pair], mid = runs[2 * pair + 1],
+                hi = runs[2 * pair + 2];
+    std::size_t na = mid - lo, nb = hi - mid;
+    splits[task] = coRank((na + nb) * part / parts, src + lo, na, src + mid,
+                          nb, less);
+  });
+  std::size_t tasks = pairs * parts + count % 2;
+  pool.parallelFor(tasks, [&](std::size_t task) {
+    std::size_t pair = task / parts, part = task % parts;
+    if (pair == pairs) { // odd run out, carried over unchanged
+      std::move(src + runs[count - 1], src + runs[count],
+                dst + runs[count - 1]);
+      return;
+    }
+    std::size_t lo = runs[2 * pair], mid = runs[2 * pair + 1],
+                hi = runs[2 * pair + 2];
+    Src a = src + lo, b = src + mid;
+    std::size_t total = hi - lo;
+    std::size_t k0 = total * part / parts, k1 = total * (part + 1) / parts;
+    std::size_t i0 = splits[pair * (parts + 1) + part];
+    std::size_t i1 = splits[pair * (parts + 1) + part + 1];
+    std::merge(std::make_move_iterator(a + i0), std::make_move_iterator(a + i1),
+               std::make_move_iterator(b + (k0 - i0)),
+               std::make_move_iterator(b + (k1 - i1)), dst + lo + k0, less);
+  });
+  std::vector<std::size_t> merged;
+  for (std::size_t r = 0; r < count; r += 2)
+    merged.push_back(runs[r]);
+  merged.push_back(runs[count]);
+  runs = std::move(merged);
+}
+
+template <typename I, typename Less>
+void mergeSort(I first, std::size_t n, Less less, ThreadPool &pool) {
+  std::size_t blocks = blockCount(n, pool);
+  if (blocks == 1) {
+    std::stable_sort(first, first + n, less);
+    return;
+  }
+  using V = std::iter_value_t<I>;
+  std::vector<V> buffer(std::make_move_iterator(first),
+                        std::make_move_iterator(first + n));
+  std::vector<std::size_t> runs(blocks + 1);
+  for (std::size_t b = 0; b <= blocks; ++b)
+    runs[b] = n * b / blocks;
+  pool.parallelFor(blocks, [&](std::size_t b) {
+    std::stable_sort(buffer.begin() + runs[b], buffer.begin() + runs[b + 1],
+                     less);
+  });
+  bool inBuffer = true;
+  while (runs.size() > 2) {
+    if (inBuffer)
+      mergeRound(buffer.begin(), first, runs, less, pool);
+    else
+      mergeRound(first, buffer.begin(), runs, less, pool);
+    inBuffer = !inBuffer;
+  }
+  if (inBuffer)
+    pool.parallelFor(blocks, [&](std::size_t b) {
+      std::size_t lo = n * b / blocks, hi = n * (b + 1) / blocks;
+      std::move(buffer.begin() + lo, buffer.begin() + hi, first + lo);
+    });
+}
+
+// moves range[perm[i]] to position i
+template <typename I, typename P>
+void gather(I first, const std::vector<P> &perm, ThreadPool &pool) {
+  using V = std::iter_value_t<I>;
+  std::size_t n = perm.size(), blocks = blockCount(n, pool);
+  if constexpr (std::is_trivially_copyable_v<V> &&
+                std::default_initializable<V>) {
+    auto buffer = std::make_unique_for_overwrite<V[]>(n);
+    pool.parallelFor(blocks, [&](std::size_t b) {
+      std::size_t lo = n * b / blocks, hi = n * (b + 1) / blocks;
+      for (std::size_t i = lo; i < hi; ++i)
+        buffer[i] = first[perm[i]];
+    });
+    pool.parallelFor(blocks, [&](std::size_t b) {
+      std::size_t lo = n * b / blocks, hi = n * (b + 1) / blocks;
+      std::copy(buffer.get() + lo, buffer.get() + hi, first + lo);
+    });
+  } else {
+    std::vector<V> buffer;
+    buffer.reserve(n);
+    for (P p : perm)
+      buffer.push_back(std::move(first[p]));
+    std::move(buffer.begin(), buffer.end(), first);
+  }
+}
+
+template <typename I, typename J, typename P, typename Less>
+void mergeSortByKey(I keys, J values, std::size_t n, Less &less,
+                    ThreadPool &pool) {
+  std::vector<P> perm(n);
+  std::iota(perm.begin(), perm.end(), P(0));
+  mergeSort(
+      perm.begin(), n,
+      [&](P a, P b) { return less(keys[a], keys[b]); }, pool);
+  gather(keys, perm, pool);
+  gather(values, perm, pool);
+}
+} // namespace sort_detail
+
+template <typename K>
+concept RadixSortable =
+    requires { typename sort_detail::RadixKey<std::remove_cv_t<K>>::Bits; };
+
+template <std::ranges::contiguous_range R>
+  requires RadixSortable<std::ranges::range_value_t<R>> &&
+           std::ranges::output_range<R, std::ranges::range_value_t<R>>
+std::ranges::borrowed_iterator_t<R>
+radixSort(R &&range, ThreadPool &pool = ThreadPool::global()) {
+  sort_detail::NoValue *none = nullptr;
+  sort_detail::radixSort(std::ranges::data(range), none,
+                         std::ranges::size(range), pool);
+  return std::ranges::next(std::ranges::begin(range), std::ranges::end(range));
+}
+
+template <std::ranges::contiguous_range RK, std::ranges::contiguous_range RV>
+  requires RadixSortable<std::ranges::range_value_t<RK>> &&
+           std::ranges::output_range<RK, std::ranges::range_value_t<RK>> &&
+           std::movable<std::ranges::range_value_t<RV>> &&
+           std::default_initializable<std::ranges::range_value_t<RV>>
+std::ranges::borrowed_iterator_t<RK>
+radixSortByKey(RK &&keys, RV &&values,
+               ThreadPool &pool = ThreadPool::global()) {
+  if (std::ranges::size(keys) != std::ranges::size(values))
+    throw std::invalid_argument("radixSortByKey: key and value counts differ");
+  sort_detail::radixSort(std::ranges::data(keys), std::ranges::data(values),
+                         std::ranges::size(keys), pool);
+  return std::ranges::next(std::ranges::begin(keys), std::ranges::end(keys));
+}
+
+template <std::ranges::random_access_range R, typename Comp = std::ranges::less,
+          typename Proj = std::identity>
+  requires std::ranges::sized_range<R> &&
+           std::sortable<std::ranges::iterator_t<R>, Comp, Proj>
+std::ranges::borrowed_iterator_t<R>
+mergeSort(R &&range, Comp comp = {}, Proj proj = {},
+          ThreadPool &pool = ThreadPool::global()) {
+  auto first = std::ranges::begin(range);
+  auto less = [&](const auto &a, const auto &b) {
+    return std::invoke(comp, std::invoke(proj, a), std::invoke(proj, b));
+  };
+  sort_detail::mergeSort(first, std::ranges::size(range), less, pool);
+  return std::ranges::next(first, std::ranges::end(range));
+}
+
+template <std::ranges::random_access_range RK,
+          std::ranges::random_access_range RV,
+          typename Comp = std::ranges::less>
+  requires std::ranges::sized_range<RK> && std::ranges::sized_range<RV> &&
+           std::indirect_strict_weak_order<Comp, std::ranges::iterator_t<RK>> &&
+           std::permutable<std::ranges::iterator_t<RK>> &&
+           std::permutable<std::ranges::iterator_t<RV>>
+std::ranges::borrowed_iterator_t<RK>
+mergeSortByKey(RK &&keys, RV &&values, Comp comp = {},
+               ThreadPool &pool = ThreadPool::global()) {
+  std::size_t n = std::ranges::size(keys);
+  if (n != std::ranges::size(values))
+    throw std::invalid_argument("mergeSortByKey: key and value counts differ");
+  auto less = [&](const auto &a, const auto &b) {
+    return std::invoke(comp, a, b);
+  };
+  auto k = std::ranges::begin(keys);
+  auto v = std::ranges::begin(values);
+  // 32 bit indices halve the permutation traffic when they suffice
+  if (n <= std::numeric_limits<uint32_t>::max())
+    sort_detail::mergeSortByKey<decltype(k), decltype(v), uint32_t>(k, v, n,
+                                                                   less, pool);
+  else
+    sort_detail::mergeSortByKey<decltype(k), decltype(v), std::size_t>(
+        k, v, n, less, pool);
+  return std::ranges::next(k, std::ranges::end(keys));
+}